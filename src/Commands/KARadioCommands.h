@@ -65,16 +65,17 @@ class KARadioCommands {
   void addCommands(TinySerialServer& server) {
     // Register CLI commands
     const char* no_parameters = ": no parameters";
-    server.addCommand("cli.start", cmd_play, no_parameters);
-    server.addCommand("cli.play", cmd_play, ": play(\"no\")");
-    server.addCommand("cli.stop", cmd_stop), no_parameters;
-    server.addCommand("cli.vol", cmd_volume, ": cli.vol[(\"0-254\")]");
-    server.addCommand("cli.vol+", cmd_volup, no_parameters);
-    server.addCommand("cli.vol-", cmd_voldown, no_parameters);
-    server.addCommand("cli.list", cmd_list, ": cli.list[(\"no\")]");
-    server.addCommand("cli.next", cmd_next, no_parameters);
-    server.addCommand("cli.prev", cmd_prev, no_parameters);
-    server.addCommand("cli.info", cmd_info, no_parameters);
+    server.addCommand("cli.start", cmd_play, this, no_parameters);
+    server.addCommand("cli.play", cmd_play, this, ": play(\"no\")");
+    server.addCommand("cli.stop", cmd_stop, this, no_parameters);
+    server.addCommand("cli.vol", cmd_volume, volumeSchema(), this,
+                      ": cli.vol[(\"0-254\")]");
+    server.addCommand("cli.vol+", cmd_volup, this, no_parameters);
+    server.addCommand("cli.vol-", cmd_voldown, this, no_parameters);
+    server.addCommand("cli.list", cmd_list, this, ": cli.list[(\"no\")]");
+    server.addCommand("cli.next", cmd_next, this, no_parameters);
+    server.addCommand("cli.prev", cmd_prev, this, no_parameters);
+    server.addCommand("cli.info", cmd_info, this, no_parameters);
     // server.addCommand("cli.instant", cmd_instant);
     //  server.addCommand("cli.name", cmd_name);
     //  server.addCommand("cli.url", cmd_url);
@@ -82,10 +83,8 @@ class KARadioCommands {
     //  server.addCommand("cli.port", cmd_port);
 
     // Register SYS commands
-    server.addCommand("sys.version", cmd_version, no_parameters);
+    server.addCommand("sys.version", cmd_version, this, no_parameters);
 
-    // Store reference to this instance in the server
-    server.setReference(this);
     server.setErrorCallback(cmd_error);
   }
 
@@ -95,7 +94,7 @@ class KARadioCommands {
    * A good way to structure things it to provide a list of directories.
    * We store a copy of the provided name.
    */
-  void addAudio(const char* name) { input_files.push_back(Str(name)); }
+  void addAudio(const char* name) { input_files.emplace_back(name); }
 
   /**
    * Enumerating files might be too slow to be useful, so we provide
@@ -109,8 +108,7 @@ class KARadioCommands {
   /**
    * @brief Error handler
    */
-  static bool cmd_error(telnet::Str& cmd,
-                        telnet::Vector<telnet::Str> parameters, Print& out,
+  static bool cmd_error(const Arguments& args, Print& out,
                         TinySerialServer* self) {
     out.println("##CMD_ERROR#");
     return true;
@@ -119,19 +117,18 @@ class KARadioCommands {
   /**
    * @brief Start playback of a station
    */
-  static bool cmd_play(telnet::Str& cmd, telnet::Vector<telnet::Str> parameters,
-                       Print& out, TinySerialServer* self) {
-    KARadioCommands* commands = (KARadioCommands*)self->getReference();
-    AudioPlayer& player = commands->audioPlayer();
+  static bool cmd_play(const Arguments& args, Print& out, void* context) {
+    KARadioCommands* commands = (KARadioCommands*)context;
     if (commands == nullptr || commands->p_player == nullptr) {
       TELNET_LOGE("%s", "KA-Radio communication not initialized");
       return false;
     }
+    AudioPlayer& player = commands->audioPlayer();
 
     // Format: cli.play [id]
-    if (parameters.size() == 1) {
+    if (args.size() == 1) {
       // Send command to KA-Radio
-      int idx = parameters[0].toInt();
+      int idx = atoi(args.c_str(0));
       TELNET_LOGI("Setting index to %d", idx);
       player.setIndex(idx);
       player.play();
@@ -148,14 +145,13 @@ class KARadioCommands {
   /**
    * @brief Stop playback
    */
-  static bool cmd_stop(telnet::Str& cmd, telnet::Vector<telnet::Str> parameters,
-                       Print& out, TinySerialServer* self) {
-    KARadioCommands* commands = (KARadioCommands*)self->getReference();
-    AudioPlayer& player = commands->audioPlayer();
+  static bool cmd_stop(const Arguments& args, Print& out, void* context) {
+    KARadioCommands* commands = (KARadioCommands*)context;
     if (commands == nullptr || commands->p_player == nullptr) {
       TELNET_LOGE("%s", "KA-Radio communication not initialized");
       return false;
     }
+    AudioPlayer& player = commands->audioPlayer();
 
     player.stop();
     out.println();
@@ -163,48 +159,50 @@ class KARadioCommands {
     return true;
   }
 
+  /// Arguments of the cli.vol command
+  struct VolumeArgs {
+    int volume;
+  };
+
+  /// Schema of the cli.vol command: the volume is optional
+  static const ArgSchema& volumeSchema() {
+    static const ArgSpec specs[] = {
+        ArgSpec::intArg("volume", offsetof(VolumeArgs, volume), 0, 254, -1)};
+    static const ArgSchema schema = ArgSchema::create<VolumeArgs>(specs);
+    return schema;
+  }
+
   /**
    * @brief Get or set volume
    */
-  static bool cmd_volume(telnet::Str& cmd,
-                         telnet::Vector<telnet::Str> parameters, Print& out,
-                         TinySerialServer* self) {
-    KARadioCommands* commands = (KARadioCommands*)self->getReference();
-    AudioPlayer& player = commands->audioPlayer();
+  static bool cmd_volume(const VolumeArgs& args, Print& out, void* context) {
+    KARadioCommands* commands = (KARadioCommands*)context;
     if (commands == nullptr || commands->p_player == nullptr) {
       TELNET_LOGE("%s", "KA-Radio communication not initialized");
       return false;
     }
 
     // Format: cli.vol [0-254]
-    if (parameters.size() == 1) {
-      // Set volume
-      int volume = atoi(parameters[0].c_str());
-      if (volume > 254) volume = 254;
-      if (volume < 0 ) volume = 0;
-      player.setVolume(static_cast<float>(volume) / 254.0);
+    if (args.volume >= 0) {
+      commands->audioPlayer().setVolume(static_cast<float>(args.volume) /
+                                        254.0);
     }
-    
-    // Get current volume
-    int volume = player.volume() * 254.0;
+
     out.println();
     printVolume(commands->audioPlayer(), out);
-
     return true;
   }
 
   /**
    * @brief Increase volume
    */
-  static bool cmd_volup(telnet::Str& cmd,
-                        telnet::Vector<telnet::Str> parameters, Print& out,
-                        TinySerialServer* self) {
-    KARadioCommands* commands = (KARadioCommands*)self->getReference();
-    AudioPlayer& player = commands->audioPlayer();
-    if (commands == nullptr) {
+  static bool cmd_volup(const Arguments& args, Print& out, void* context) {
+    KARadioCommands* commands = (KARadioCommands*)context;
+    if (commands == nullptr || commands->p_player == nullptr) {
       TELNET_LOGE("%s", "KA-Radio communication not initialized");
       return false;
     }
+    AudioPlayer& player = commands->audioPlayer();
 
     float volume = player.volume();
     volume += 0.05;
@@ -220,15 +218,13 @@ class KARadioCommands {
   /**
    * @brief Decrease volume
    */
-  static bool cmd_voldown(telnet::Str& cmd,
-                          telnet::Vector<telnet::Str> parameters, Print& out,
-                          TinySerialServer* self) {
-    KARadioCommands* commands = (KARadioCommands*)self->getReference();
-    AudioPlayer& player = commands->audioPlayer();
+  static bool cmd_voldown(const Arguments& args, Print& out, void* context) {
+    KARadioCommands* commands = (KARadioCommands*)context;
     if (commands == nullptr || commands->p_player == nullptr) {
       TELNET_LOGE("%s", "KA-Radio communication not initialized");
       return false;
     }
+    AudioPlayer& player = commands->audioPlayer();
 
     float volume = player.volume();
     ;
@@ -243,60 +239,69 @@ class KARadioCommands {
   }
 
   /**
-   * @brief List stations
+   * @brief List stations: resumable command which lists one station per step
    */
-  static bool cmd_list(telnet::Str& cmd, telnet::Vector<telnet::Str> parameters,
-                       Print& out, TinySerialServer* self) {
-    KARadioCommands* commands = (KARadioCommands*)self->getReference();
+  static StepResult cmd_list(CommandState& state, Print& out,
+                             TinySerialServer* self) {
+    KARadioCommands* commands = (KARadioCommands*)state.context;
     if (commands == nullptr || commands->p_player == nullptr) {
       TELNET_LOGE("%s", "KA-Radio communication not initialized");
-      return false;
+      return StepResult::Error;
     }
 
     AudioPlayer& player = commands->audioPlayer();
     AudioSource& source = player.audioSource();
-    int original_idx = source.index();
-
-    // Check if we're listing a specific index
-    int specific_index = -1;
-    if (parameters.size() > 0) {
-      specific_index = parameters[0].toInt();
-      TELNET_LOGI("Requested specific item index: %d", specific_index);
-      // Convert from 1-based (user visible) to 0-based (internal)
-      specific_index = specific_index > 0 ? specific_index - 1 : -1;
-    }
 
-    out.println();
-    out.println("##CLI.LIST#");
+    if (state.step == 0) {
+      // Check if we're listing a specific index
+      int specific_index = -1;
+      if (state.parameters.size() > 0) {
+        specific_index = state.parameters[0].toInt();
+        TELNET_LOGI("Requested specific item index: %d", specific_index);
+        // Convert from 1-based (user visible) to 0-based (internal)
+        specific_index = specific_index > 0 ? specific_index - 1 : -1;
+      }
 
-    // List items based on priority
-    if (input_files.size() > 0) {
-      listFromInputFiles(out, specific_index);
-    } else if (input_files_refs.size() > 0) {
-      listFromInputFileRefs(out, specific_index);
+      out.println();
+      out.println("##CLI.LIST#");
+
+      // Remember the original position which is restored at the end
+      ListState* list = new ListState();
+      list->p_source = &source;
+      list->original_idx = source.index();
+      state.data = list;
+      state.cleanup = restoreListState;
+
+      if (specific_index < 0) return StepResult::Continue;
+      TELNET_LOGI("Item at index %d", specific_index);
+      if (!listItem(source, out, specific_index)) {
+        TELNET_LOGW("No item found at index %d", specific_index + 1);
+      }
     } else {
-      listFromAudioSource(source, out, specific_index);
+      // list the next item
+      int idx = state.step - 1;
+      if (max_input_files > 0 && idx >= max_input_files) {
+        TELNET_LOGI("max limit reached: %d", max_input_files);
+      } else if (listItem(source, out, idx)) {
+        return StepResult::Continue;
+      }
     }
 
     out.println("##CLI.LIST#");
     out.println();
-
-    // Restore original position
-    source.setIndex(original_idx);
-    return true;
+    return StepResult::Done;
   }
 
   /**
    * @brief Switch to next station
    */
-  static bool cmd_next(telnet::Str& cmd, telnet::Vector<telnet::Str> parameters,
-                       Print& out, TinySerialServer* self) {
-    KARadioCommands* commands = (KARadioCommands*)self->getReference();
-    AudioPlayer& player = commands->audioPlayer();
+  static bool cmd_next(const Arguments& args, Print& out, void* context) {
+    KARadioCommands* commands = (KARadioCommands*)context;
     if (commands == nullptr || commands->p_player == nullptr) {
       TELNET_LOGE("%s", "KA-Radio communication not initialized");
       return false;
     }
+    AudioPlayer& player = commands->audioPlayer();
 
     player.next();
     out.println();
@@ -307,14 +312,13 @@ class KARadioCommands {
   /**
    * @brief Switch to previous station
    */
-  static bool cmd_prev(telnet::Str& cmd, telnet::Vector<telnet::Str> parameters,
-                       Print& out, TinySerialServer* self) {
-    KARadioCommands* commands = (KARadioCommands*)self->getReference();
-    AudioPlayer& player = commands->audioPlayer();
+  static bool cmd_prev(const Arguments& args, Print& out, void* context) {
+    KARadioCommands* commands = (KARadioCommands*)context;
     if (commands == nullptr || commands->p_player == nullptr) {
       TELNET_LOGE("%s", "KA-Radio communication not initialized");
       return false;
     }
+    AudioPlayer& player = commands->audioPlayer();
 
     player.previous();
     out.println();
@@ -364,9 +368,8 @@ class KARadioCommands {
   /**
    * @brief Show current radio info
    */
-  static bool cmd_info(telnet::Str& cmd, telnet::Vector<telnet::Str> parameters,
-                       Print& out, TinySerialServer* self) {
-    KARadioCommands* commands = (KARadioCommands*)self->getReference();
+  static bool cmd_info(const Arguments& args, Print& out, void* context) {
+    KARadioCommands* commands = (KARadioCommands*)context;
     if (commands == nullptr || commands->p_player == nullptr) {
       TELNET_LOGE("%s", "KA-Radio communication not initialized");
       return false;
@@ -484,10 +487,8 @@ class KARadioCommands {
   /**
    * @brief Get firmware version
    */
-  static bool cmd_version(telnet::Str& cmd,
-                          telnet::Vector<telnet::Str> parameters, Print& out,
-                          TinySerialServer* self) {
-    KARadioCommands* commands = (KARadioCommands*)self->getReference();
+  static bool cmd_version(const Arguments& args, Print& out, void* context) {
+    KARadioCommands* commands = (KARadioCommands*)context;
     if (commands == nullptr || commands->p_player == nullptr) {
       TELNET_LOGE("%s", "KA-Radio communication not initialized");
       return false;
@@ -578,87 +579,41 @@ class KARadioCommands {
     out.println();
   }
 
-  /**
-   * @brief List stations from input_files
-   *
-   * @param out Output stream
-   * @param specific_index Index to show (-1 for all)
-   */
-  static void listFromInputFiles(Print& out, int specific_index) {
-    if (specific_index > 0) {
-      printListItem(out, specific_index, input_files[specific_index-1].c_str());
-      return;
-    }
-
-    for (int i = 0; i < input_files.size(); i++) {
-      printListItem(out, i + 1, input_files[i].c_str());
-
-      // Check max limit
-      if (max_input_files > 0 && i >= max_input_files - 1) {
-        TELNET_LOGI("max limit reached: %d", max_input_files);
-        break;
-      }
-    }
+  /// Position of the audio source before the cli.list command
+  struct ListState {
+    AudioSource* p_source = nullptr;
+    int original_idx = 0;
+  };
+
+  /// Restores the original position of the audio source
+  static void restoreListState(CommandState& state) {
+    ListState* list = (ListState*)state.data;
+    list->p_source->setIndex(list->original_idx);
+    delete list;
   }
 
   /**
-   * @brief List stations from input_files_refs
-   *
-   * @param out Output stream
-   * @param specific_index Index to show (-1 for all)
-   */
-  static void listFromInputFileRefs(Print& out, int specific_index) {
-    if (specific_index > 0) {
-      printListItem(out, specific_index, input_files_refs[specific_index-1]);
-      return;
-    }
-
-    for (int i = 0; i < input_files_refs.size(); i++) {
-      printListItem(out, i + 1, input_files_refs[i]);
-
-      // Check max limit
-      if (max_input_files > 0 && i >= max_input_files - 1) {
-        TELNET_LOGI("max limit reached: %d", max_input_files);
-        break;
-      }
-    }
-  }
-
-  /**
-   * @brief List stations from AudioSource
+   * @brief List a single station: the stations are taken from input_files,
+   * input_files_refs or the AudioSource
    *
    * @param source The AudioSource to list from
    * @param out Output stream
-   * @param specific_index Index to show (-1 for all)
+   * @param idx 0 based index of the station
+   * @return false if there is no station at the index
    */
-  static void listFromAudioSource(AudioSource& source, Print& out,
-                                  int specific_index) {
-    // If requesting a specific index, try to jump directly to it
-    if (specific_index >= 0) {
-      TELNET_LOGI("Item at index %d", specific_index);
-      if (source.setIndex(specific_index)) {
-        printListItem(out, specific_index + 1, source.toStr());
-      } else {
-        TELNET_LOGW("No item found at index %d", specific_index + 1);
-      }
-      return;
-    }
-
-    // Otherwise list all items
-    int idx = 0;
-    int count = 0;
-    while (source.setIndex(idx)) {
+  static bool listItem(AudioSource& source, Print& out, int idx) {
+    if (idx < 0) return false;
+    if (input_files.size() > 0) {
+      if (idx >= input_files.size()) return false;
+      printListItem(out, idx + 1, input_files[idx].c_str());
+    } else if (input_files_refs.size() > 0) {
+      if (idx >= input_files_refs.size()) return false;
+      printListItem(out, idx + 1, input_files_refs[idx]);
+    } else {
+      if (!source.setIndex(idx)) return false;
       printListItem(out, idx + 1, source.toStr());
-      count++;
-
-      // Check max limit
-      if (max_input_files > 0 && count >= max_input_files) {
-        TELNET_LOGI("max limit reached: %d", max_input_files);
-        break;
-      }
-
-      idx++;
     }
+    return true;
   }
 };
 
@@ -58,9 +58,11 @@ class SDFileCommands {
     server.addCommand("df", cmd_df);
     server.addCommand("touch", cmd_touch, "FILENAME");
     server.addCommand("write", cmd_write, "FILENAME TEXT");
-    server.addCommand("head", cmd_head, "[-n lines] FILENAME");
+    server.addCommand("head", cmd_head, headSchema(), nullptr,
+                      "[-n lines] FILENAME");
     server.addCommand("cd", cmd_cd, "DIRECTORY");
     server.addCommand("pwd", cmd_pwd);
+    server.setCompleter(completePath);
   }
 
   /**
@@ -79,9 +81,11 @@ class SDFileCommands {
     server.addCommand("chkdsk", cmd_df);
     server.addCommand("touch", cmd_touch, "FILENAME");
     server.addCommand("write", cmd_write, "FILENAME TEXT");
-    server.addCommand("head", cmd_head, "[-n lines] FILENAME");
+    server.addCommand("head", cmd_head, headSchema(), nullptr,
+                      "[-n lines] FILENAME");
     server.addCommand("cd", cmd_cd, "DIRECTORY");
     server.addCommand("pwd", cmd_pwd);
+    server.setCompleter(completePath);
   }
 
 
@@ -164,29 +168,32 @@ class SDFileCommands {
     return true;
   }
 
+  /// Arguments of the head command
+  struct HeadArgs {
+    int lines;
+    const char* file;
+  };
+
+  /// Schema of the head command: [-n lines] FILENAME
+  static const ArgSchema& headSchema() {
+    static const ArgSpec specs[] = {
+        ArgSpec::intArg("-n", offsetof(HeadArgs, lines), 1, 100000, 10),
+        ArgSpec::stringArg("FILENAME", offsetof(HeadArgs, file), nullptr,
+                           true)};
+    static const ArgSchema schema = ArgSchema::create<HeadArgs>(specs);
+    return schema;
+  }
+
   /**
    * @brief Show first N lines of a file
    */
-  static bool cmd_head(telnet::Str& cmd, telnet::Vector<telnet::Str> parameters,
-                       Print& out, TinySerialServer* self) {
-    if (parameters.size() != 1 || parameters[0].length() == 0) {
-      out.println("Usage: head [-n lines] <filename>");
-      return false;
-    }
-
-    int numLines = 10;  // Default
+  static bool cmd_head(const HeadArgs& args, Print& out, void* context) {
+    int numLines = args.lines;
 
     // resolve file name
-    String fstr = resolveName(parameters[0].c_str());
+    String fstr = resolveName(args.file);
     const char* filename = fstr.c_str();
 
-    // Check for -n parameter
-    if (parameters.size() > 2 && parameters[0] == "-n" &&
-        parameters[1].length() > 0) {
-      numLines = atoi(parameters[1].c_str());
-      filename = parameters[2].c_str();
-    }
-
     if (!SD.exists(filename)) {
       out.print("Error: File not found: ");
       out.println(filename);
@@ -280,15 +287,18 @@ class SDFileCommands {
   }
 
   /**
-   * @brief Copy a file
+   * @brief Copy a file: resumable command which copies one block per step
    */
-  static bool cmd_cp(telnet::Str& cmd, telnet::Vector<telnet::Str> parameters,
-                     Print& out, TinySerialServer* self) {
+  static StepResult cmd_cp(CommandState& state, Print& out,
+                           TinySerialServer* self) {
+    if (state.step > 0) return copyStep(state, out);
+
+    telnet::Vector<telnet::Str>& parameters = state.parameters;
     if (parameters.size() != 2 || parameters[0].length() == 0 ||
         parameters[1].length() == 0) {
       out.println("Usage: cp <source> <destination>");
       out.println();
-      return false;
+      return StepResult::Error;
     }
 
     // resolve directory name
@@ -301,7 +311,7 @@ class SDFileCommands {
       out.print("Error: Source file not found: ");
       out.println(source);
       out.println();
-      return false;
+      return StepResult::Error;
     }
 
     File sourceFile = SD.open(source);
@@ -309,14 +319,14 @@ class SDFileCommands {
       out.print("Error: Could not open source file: ");
       out.println(source);
       out.println();
-      return false;
+      return StepResult::Error;
     }
 
     if (sourceFile.isDirectory()) {
       out.println("Error: Cannot copy directories (use cp -r for that)");
       sourceFile.close();
       out.println();
-      return false;
+      return StepResult::Error;
     }
 
     File destFile = SD.open(destination, FILE_WRITE);
@@ -325,30 +335,18 @@ class SDFileCommands {
       out.println(destination);
       out.println();
       sourceFile.close();
-      return false;
-    }
-
-    // Copy file contents
-    const size_t bufferSize = 512;
-    uint8_t buffer[bufferSize];
-
-    while (sourceFile.available()) {
-      size_t bytesRead = sourceFile.read(buffer, bufferSize);
-      if (bytesRead > 0) {
-        destFile.write(buffer, bytesRead);
-      }
-    }
-
-    sourceFile.close();
-    destFile.close();
-
-    out.print("Copied '");
-    out.print(source);
-    out.print("' to '");
-    out.print(destination);
-    out.println("'");
-    out.println();
-    return true;
+      return StepResult::Error;
+    }
+
+    // the file contents is copied in the next steps
+    CopyState* copy = new CopyState();
+    copy->source = sourceFile;
+    copy->destination = destFile;
+    copy->source_name = src_str;
+    copy->destination_name = dst_str;
+    state.data = copy;
+    state.cleanup = closeCopy;
+    return StepResult::Continue;
   }
 
   /**
@@ -424,9 +422,7 @@ class SDFileCommands {
     out.println(path);
     out.println();
     out.print("Name");
-    for (int j=0;j<max_file_length - 4;j++) {
-      out.print(" ");
-    }
+    printPadding(out, max_file_length - 4);
     out.println("Type      Size");
     
 
@@ -448,10 +444,7 @@ class SDFileCommands {
       out.print(name);
 
       // Padding
-      int nameLen = strlen(name);
-      for (int i = nameLen; i < max_file_length; i++) {
-        out.print(" ");
-      }
+      printPadding(out, max_file_length - strlen(name));
 
       // Print size or <DIR>
       if (entry.isDirectory()) {
@@ -474,16 +467,20 @@ class SDFileCommands {
   }
 
   /**
-   * @brief Display contents of a file
+   * @brief Display contents of a file: resumable command which prints one
+   * block per step
    */
-  static bool cmd_cat(telnet::Str& cmd, telnet::Vector<telnet::Str> parameters,
-                      Print& out, TinySerialServer* self) {
+  static StepResult cmd_cat(CommandState& state, Print& out,
+                            TinySerialServer* self) {
+    if (state.step > 0) return catStep(state, out);
+
     // Require a filename parameter
+    telnet::Vector<telnet::Str>& parameters = state.parameters;
     if (parameters.size() != 1 || parameters[0].length() == 0) {
       out.println("Usage: cat <filename>");
       out.println();
 
-      return false;
+      return StepResult::Error;
     }
 
     // resolve file name
@@ -495,7 +492,7 @@ class SDFileCommands {
       out.print("Error: File not found: ");
       out.println(filename);
       out.println();
-      return false;
+      return StepResult::Error;
     }
 
     // Open file
@@ -504,7 +501,7 @@ class SDFileCommands {
       out.print("Error: Could not open file ");
       out.println(filename);
       out.println();
-      return false;
+      return StepResult::Error;
     }
 
     // Check if it's a directory
@@ -513,28 +510,15 @@ class SDFileCommands {
       out.println(" is a directory");
       file.close();
       out.println();
-      return false;
+      return StepResult::Error;
     }
 
-    // Read and display the file
+    // Read and display the file in the next steps
     out.print("File: ");
     out.println(filename);
-
-    // Read file contents
-    while (file.available()) {
-      char buffer[64];
-      size_t bytesRead = file.readBytes(buffer, sizeof(buffer) - 1);
-
-      if (bytesRead > 0) {
-        buffer[bytesRead] = '\0';  // Null-terminate the string
-        out.write(buffer, bytesRead);
-      }
-    }
-
-    file.close();
-    out.println("*** END ***");
-    out.println();
-    return true;
+    state.data = new File(file);
+    state.cleanup = closeFile;
+    return StepResult::Continue;
   }
 
   /**
@@ -630,11 +614,15 @@ class SDFileCommands {
   }
 
   /**
-   * @brief Remove a file or directory
+   * @brief Remove a file or directory: resumable command which removes one
+   * directory entry per step
    */
-  static bool cmd_rm(telnet::Str& cmd, telnet::Vector<telnet::Str> parameters,
-                     Print& out, TinySerialServer* self) {
+  static StepResult cmd_rm(CommandState& state, Print& out,
+                           TinySerialServer* self) {
+    if (state.step > 0) return removeStep(state, out);
+
     // Check for recursive flag
+    telnet::Vector<telnet::Str>& parameters = state.parameters;
     bool recursive = false;
     int fileIndex = 0;
 
@@ -647,7 +635,7 @@ class SDFileCommands {
     if (parameters.size() <= fileIndex || parameters[fileIndex].length() == 0) {
       out.println("Usage: rm [-r] <filename>");
       out.println();
-      return false;
+      return StepResult::Error;
     }
 
     /// resolve file name
@@ -659,7 +647,7 @@ class SDFileCommands {
       out.print("Error: File not found: ");
       out.println(filename);
       out.println();
-      return false;
+      return StepResult::Error;
     }
 
     // Check if it's a directory
@@ -670,31 +658,31 @@ class SDFileCommands {
     if (isDir && !recursive) {
       out.println("Error: Cannot remove directory without -r flag");
       out.println();
-      return false;
+      return StepResult::Error;
     }
 
     if (isDir && recursive) {
-      // Remove directory recursively
-      if (!removeDirectory(filename, out)) {
-        out.print("Error: Failed to remove directory: ");
-        out.println(filename);
-        out.println();
-        return false;
-      }
-    } else {
-      // Remove file
-      if (!SD.remove(filename)) {
-        out.print("Error: Failed to remove file: ");
-        out.println(filename);
-        out.println();
-        return false;
-      }
+      // Remove directory recursively in the next steps
+      RemoveState* remove = new RemoveState();
+      remove->root = fstr;
+      remove->current = fstr;
+      state.data = remove;
+      state.cleanup = deleteRemoveState;
+      return StepResult::Continue;
+    }
+
+    // Remove file
+    if (!SD.remove(filename)) {
+      out.print("Error: Failed to remove file: ");
+      out.println(filename);
+      out.println();
+      return StepResult::Error;
     }
 
     out.print("Removed ");
     out.println(filename);
     out.println();
-    return true;
+    return StepResult::Done;
   }
 
   static bool cmd_pwd(telnet::Str& cmd, telnet::Vector<telnet::Str> parameters,
@@ -752,6 +740,47 @@ class SDFileCommands {
   }
 
  protected:
+  /// Prints the indicated number of spaces
+  static void printPadding(Print& out, int len) {
+    static const char spaces[] = "                                ";
+    while (len > 0) {
+      int n = len < (int)sizeof(spaces) - 1 ? len : sizeof(spaces) - 1;
+      out.write(spaces, n);
+      len -= n;
+    }
+  }
+
+  /// Provides the file names which can complete the parameter: directories
+  /// end with a /
+  static void completePath(const char* cmd, Completion& completion,
+                           void* context) {
+    // split the word into directory and file name
+    const char* word = completion.word();
+    const char* slash = strrchr(word, '/');
+    int dir_len = slash == nullptr ? 0 : slash - word + 1;
+    String prefix = String(word).substring(0, dir_len);
+    String dir_name = dir_len == 0 ? current_dir : resolveName(prefix.c_str());
+    if (dir_name.length() > 1 && dir_name.endsWith("/")) {
+      dir_name = dir_name.substring(0, dir_name.length() - 1);
+    }
+    File dir = SD.open(dir_name.c_str());
+    if (!dir || !dir.isDirectory()) return;
+    File entry;
+    while (entry = dir.openNextFile()) {
+      // depending on the core we get the full path or only the name
+      const char* name = strrchr(entry.name(), '/');
+      name = name == nullptr ? entry.name() : name + 1;
+      // Skip hidden files
+      if (name[0] != '.') {
+        String candidate = prefix + name;
+        if (entry.isDirectory()) candidate += "/";
+        completion.add(candidate.c_str());
+      }
+      entry.close();
+    }
+    dir.close();
+  }
+
   /// Resolve relative path name
   static String resolveName(const char* path) {
     if (String(path).startsWith("/")) {
@@ -784,62 +813,138 @@ class SDFileCommands {
     }
     return result;
   }
+  /// Open files of a running cp command
+  struct CopyState {
+    File source;
+    File destination;
+    String source_name;
+    String destination_name;
+  };
+
+  /// Directories of a running rm -r command
+  struct RemoveState {
+    String root;
+    String current;
+  };
+
+  /// Copies the next block of the file
+  static StepResult copyStep(CommandState& state, Print& out) {
+    CopyState* copy = (CopyState*)state.data;
+    if (copy->source.available()) {
+      const size_t bufferSize = 512;
+      uint8_t buffer[bufferSize];
+      size_t bytesRead = copy->source.read(buffer, bufferSize);
+      if (bytesRead > 0) {
+        copy->destination.write(buffer, bytesRead);
+      }
+      return StepResult::Continue;
+    }
+
+    out.print("Copied '");
+    out.print(copy->source_name);
+    out.print("' to '");
+    out.print(copy->destination_name);
+    out.println("'");
+    out.println();
+    return StepResult::Done;
+  }
+
+  /// Closes the files of the cp command
+  static void closeCopy(CommandState& state) {
+    CopyState* copy = (CopyState*)state.data;
+    copy->source.close();
+    copy->destination.close();
+    delete copy;
+  }
+
+  /// Prints the next block of the file
+  static StepResult catStep(CommandState& state, Print& out) {
+    File& file = *(File*)state.data;
+    if (file.available()) {
+      char buffer[64];
+      size_t bytesRead = file.readBytes(buffer, sizeof(buffer));
+      if (bytesRead > 0) {
+        size_t written = out.write((const uint8_t*)buffer, bytesRead);
+        // the output is full: we repeat the rest in the next step
+        if (written < bytesRead) {
+          file.seek(file.position() - (bytesRead - written));
+        }
+      }
+      return StepResult::Continue;
+    }
+    out.println("*** END ***");
+    out.println();
+    return StepResult::Done;
+  }
+
+  /// Closes the file of the cat command
+  static void closeFile(CommandState& state) {
+    File* file = (File*)state.data;
+    file->close();
+    delete file;
+  }
+
   /**
-   * @brief Remove a directory and all its contents recursively
-   *
-   * @param dirPath Path to directory
-   * @param out Output stream for messages
-   * @return true if successful
+   * @brief Removes the next entry of the current directory: we descend into
+   * subdirectories and remove the empty directories on the way back up to
+   * the root of the rm -r command.
    */
-  static bool removeDirectory(const char* dirPath, Print& out) {
+  static StepResult removeStep(CommandState& state, Print& out) {
+    RemoveState* remove = (RemoveState*)state.data;
+    const char* dirPath = remove->current.c_str();
     File dir = SD.open(dirPath);
     if (!dir) {
-      return false;
+      out.print("Error: Failed to remove directory: ");
+      out.println(remove->root);
+      out.println();
+      return StepResult::Error;
     }
 
-    if (!dir.isDirectory()) {
+    File file = dir.openNextFile();
+    if (!file) {
+      // directory is empty: remove it and continue with the parent
       dir.close();
-      return SD.remove(dirPath);
-    }
-
-    // Remove all files in directory
-    File file;
-    while (file = dir.openNextFile()) {
-      char filePath[100];  // Adjust size as needed
-
-      // Construct full path
-      strcpy(filePath, dirPath);
-
-      // Add slash if needed
-      if (dirPath[strlen(dirPath) - 1] != '/') {
-        strcat(filePath, "/");
+      if (!SD.rmdir(dirPath)) {
+        out.print("Error: Failed to remove directory: ");
+        out.println(remove->root);
+        out.println();
+        return StepResult::Error;
       }
-
-      strcat(filePath, file.name());
-
-      if (file.isDirectory()) {
-        // Recursively remove subdirectory
-        file.close();
-        if (!removeDirectory(filePath, out)) {
-          dir.close();
-          return false;
-        }
-      } else {
-        // Remove file
-        file.close();
-        if (!SD.remove(filePath)) {
-          out.print("Failed to remove: ");
-          out.println(filePath);
-          dir.close();
-          return false;
-        }
+      if (remove->current == remove->root) {
+        out.print("Removed ");
+        out.println(remove->root);
+        out.println();
+        return StepResult::Done;
       }
+      remove->current = dirUp(dirPath);
+      return StepResult::Continue;
     }
 
+    // Construct full path
+    String filePath = remove->current;
+    if (!filePath.endsWith("/")) filePath += "/";
+    filePath += file.name();
+    bool isDir = file.isDirectory();
+    file.close();
     dir.close();
 
-    // Finally remove the empty directory
-    return SD.rmdir(dirPath);
+    if (isDir) {
+      // descend into subdirectory
+      remove->current = filePath;
+    } else if (!SD.remove(filePath.c_str())) {
+      out.print("Failed to remove: ");
+      out.println(filePath);
+      out.print("Error: Failed to remove directory: ");
+      out.println(remove->root);
+      out.println();
+      return StepResult::Error;
+    }
+    return StepResult::Continue;
+  }
+
+  /// Releases the state of the rm command
+  static void deleteRemoveState(CommandState& state) {
+    delete (RemoveState*)state.data;
   }
 };
 
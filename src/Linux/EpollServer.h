@@ -0,0 +1,394 @@
+#pragma once
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/sockios.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/// The epoll backend serves many clients: the sessions are allocated with
+/// the TinyTelnetServer, so include this header before TinyTelnetServer.h
+/// or define MAX_CLIENTS yourself
+#ifndef MAX_CLIENTS
+#  define MAX_CLIENTS 1024
+#endif
+
+#include "Client.h"
+#include "../TinyTelnetServerConfig.h"
+#include "../Utils/Logger.h"
+#include "../Utils/Vector.h"
+
+namespace telnet {
+
+/**
+ * @brief Nonblocking socket which is shared by all copies of an EpollClient.
+ * The readiness is updated by the EpollServer from the epoll events, so we
+ * only need to call the OS when the socket is ready.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct EpollSocket {
+  int fd = -1;
+  /// number of EpollClient objects which refer to this socket
+  int ref_count = 0;
+  /// data can be read w/o blocking
+  bool is_readable = false;
+  /// data can be written w/o blocking
+  bool is_writable = true;
+  /// the peer has closed the connection
+  bool is_peer_closed = false;
+  /// session slot which is reported when the socket gets ready (-1 = none)
+  int slot = -1;
+  /// size of the send buffer: it is determined once when we accept
+  int send_buffer_size = 0;
+  /// free space in the send buffer which was determined in write_space_pass
+  int write_space = 0;
+  unsigned long write_space_pass = 0;
+  uint8_t rx_buffer[EPOLL_RX_BUFFER_SIZE];
+  int rx_pos = 0;
+  int rx_len = 0;
+
+  ~EpollSocket() { close(); }
+
+  /// Closes the socket: it is automatically removed from the epoll set
+  void close() {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+    rx_pos = rx_len = 0;
+  }
+
+  /// Number of buffered bytes: we only call recv() if epoll reported the
+  /// socket as readable
+  int available() {
+    if (rx_pos < rx_len) return rx_len - rx_pos;
+    if (fd < 0 || !is_readable) return 0;
+    rx_pos = rx_len = 0;
+    int len = ::recv(fd, rx_buffer, sizeof(rx_buffer), MSG_DONTWAIT);
+    if (len > 0) {
+      rx_len = len;
+    } else if (len == 0) {
+      is_peer_closed = true;
+      is_readable = false;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      // edge triggered: we wait for the next event
+      is_readable = false;
+    } else if (errno != EINTR) {
+      is_peer_closed = true;
+      is_readable = false;
+    }
+    return rx_len;
+  }
+
+  /// Number of bytes which can be written w/o blocking: we ask the OS only
+  /// once per pass and subtract what we have written since then
+  int availableForWrite() {
+    if (fd < 0 || !is_writable) return 0;
+    if (write_space_pass != pass()) {
+      int queued = 0;
+      if (ioctl(fd, SIOCOUTQ, &queued) < 0) return 0;
+      write_space =
+          send_buffer_size > queued ? send_buffer_size - queued : 0;
+      write_space_pass = pass();
+    }
+    return write_space;
+  }
+
+  /// Counter which is incremented by the EpollServer with each wait: the
+  /// cached values of the sockets are only valid for one pass
+  static unsigned long& pass() {
+    static unsigned long count = 1;
+    return count;
+  }
+
+  /// Writes as much as possible w/o blocking
+  size_t write(const uint8_t* data, size_t len) {
+    if (fd < 0) return 0;
+    ssize_t result = ::send(fd, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (result < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        is_writable = false;
+        write_space = 0;
+      } else if (errno != EINTR) {
+        is_peer_closed = true;
+      }
+      return 0;
+    }
+    if ((size_t)result < len) is_writable = false;
+    write_space = write_space > result ? write_space - result : 0;
+    return result;
+  }
+};
+
+/**
+ * @brief Client for the EpollServer: all copies share the same socket which
+ * is closed with stop() or when the last copy is deleted.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class EpollClient : public Client {
+ public:
+  EpollClient() = default;
+  EpollClient(EpollSocket* socket) { attach(socket); }
+  EpollClient(const EpollClient& other) : Client() { attach(other.p_socket); }
+  ~EpollClient() { attach(nullptr); }
+
+  EpollClient& operator=(const EpollClient& other) {
+    if (this != &other) attach(other.p_socket);
+    return *this;
+  }
+
+  /// Outgoing connections are not supported
+  int connect(IPAddress ip, uint16_t port) override { return 0; }
+  /// Outgoing connections are not supported
+  int connect(const char* host, uint16_t port) override { return 0; }
+
+  size_t write(uint8_t value) override { return write(&value, 1); }
+
+  size_t write(const uint8_t* data, size_t len) override {
+    if (p_socket == nullptr) return 0;
+    return p_socket->write(data, len);
+  }
+
+  int availableForWrite() override {
+    if (p_socket == nullptr) return 0;
+    return p_socket->availableForWrite();
+  }
+
+  int available() override {
+    if (p_socket == nullptr) return 0;
+    return p_socket->available();
+  }
+
+  int read() override {
+    if (available() <= 0) return -1;
+    return p_socket->rx_buffer[p_socket->rx_pos++];
+  }
+
+  int read(uint8_t* data, size_t len) override {
+    int result = available();
+    if (result <= 0) return -1;
+    if ((size_t)result > len) result = len;
+    memcpy(data, p_socket->rx_buffer + p_socket->rx_pos, result);
+    p_socket->rx_pos += result;
+    return result;
+  }
+
+  int peek() override {
+    if (available() <= 0) return -1;
+    return p_socket->rx_buffer[p_socket->rx_pos];
+  }
+
+  /// The data is sent immediately: nothing to do
+  void flush() override {}
+
+  void stop() override {
+    if (p_socket != nullptr) p_socket->close();
+  }
+
+  /// Defines the session slot which is reported by the EpollServer when the
+  /// socket gets ready
+  void setSlot(int slot) {
+    if (p_socket != nullptr) p_socket->slot = slot;
+  }
+
+  /// We report the connection as closed as soon as the peer has closed it
+  /// and all received data has been consumed: the socket is closed then.
+  uint8_t connected() override {
+    if (p_socket == nullptr || p_socket->fd < 0) return false;
+    if (p_socket->is_peer_closed && p_socket->available() == 0) {
+      p_socket->close();
+      return false;
+    }
+    return true;
+  }
+
+  operator bool() override { return connected(); }
+
+ protected:
+  EpollSocket* p_socket = nullptr;
+
+  /// Shares the socket: the last client deletes it
+  void attach(EpollSocket* socket) {
+    if (socket != nullptr) socket->ref_count++;
+    if (p_socket != nullptr && --p_socket->ref_count == 0) delete p_socket;
+    p_socket = socket;
+  }
+};
+
+/**
+ * @brief Linux server based on nonblocking sockets and epoll which can be
+ * used as template parameter for the TinyTelnetServer:
+ *
+ * EpollServer epoll(9023);
+ * TinyTelnetServer<EpollServer, EpollClient> server(epoll);
+ *
+ * The server collects the session slots of the sockets which got ready, so
+ * that the TinyTelnetServer only serves these sessions (and the sessions
+ * which did not finish their work) instead of checking all of them. When
+ * there is nothing to do, it blocks in epoll_wait() until a descriptor gets
+ * ready or the next idle timer is due. The clients remember their
+ * readiness, so idle clients do not cause any system calls. Use MAX_CLIENTS
+ * to define the number of sessions.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class EpollServer {
+ public:
+  EpollServer(int port = 23) { this->port = port; }
+  ~EpollServer() { end(); }
+
+  /// Opens the listening socket
+  bool begin() {
+    if (listen_fd >= 0) return true;
+    listen_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+      TELNET_LOGE("socket failed: %d", errno);
+      return false;
+    }
+    int on = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (::bind(listen_fd, (sockaddr*)&address, sizeof(address)) < 0 ||
+        ::listen(listen_fd, SOMAXCONN) < 0) {
+      TELNET_LOGE("bind/listen on port %d failed: %d", port, errno);
+      end();
+      return false;
+    }
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = nullptr;
+    if (epoll_fd < 0 ||
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) < 0) {
+      TELNET_LOGE("epoll setup failed: %d", errno);
+      end();
+      return false;
+    }
+    // accept the connections which might be pending already
+    is_accept_ready = true;
+    return true;
+  }
+
+  /// Closes the listening socket: the clients stay open
+  void end() {
+    if (epoll_fd >= 0) ::close(epoll_fd);
+    if (listen_fd >= 0) ::close(listen_fd);
+    epoll_fd = listen_fd = -1;
+  }
+
+  /// Provides the next new connection: returns an unconnected client if
+  /// there is none
+  EpollClient accept() {
+    if (listen_fd < 0 || !is_accept_ready) return EpollClient();
+    int fd = ::accept4(listen_fd, nullptr, nullptr,
+                       SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) is_accept_ready = false;
+      return EpollClient();
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    EpollSocket* socket = new EpollSocket();
+    socket->fd = fd;
+    socklen_t len = sizeof(socket->send_buffer_size);
+    getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &socket->send_buffer_size, &len);
+    // edge triggered: we might have missed data received before the add
+    socket->is_readable = true;
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = socket;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+      TELNET_LOGE("epoll_ctl failed: %d", errno);
+      delete socket;
+      return EpollClient();
+    }
+    return EpollClient(socket);
+  }
+
+  /// Calls the callback with the session slot of each socket which got
+  /// ready since the last call: returns false if the server is not active
+  template <class Callback>
+  bool readyClients(Callback callback) {
+    if (epoll_fd < 0) return false;
+    for (int j = 0; j < ready_slots.size(); j++) callback(ready_slots[j]);
+    ready_slots.clear();
+    return true;
+  }
+
+  /// Waits max the indicated time (-1 = until an event arrives) for any
+  /// socket to become ready and updates the readiness of the sockets
+  void wait(int timeout_ms) {
+    // the cached write space of the sockets needs to be determined again
+    EpollSocket::pass()++;
+    if (epoll_fd < 0) {
+      if (timeout_ms > 0) delay(timeout_ms);
+      return;
+    }
+    epoll_event events[EPOLL_MAX_EVENTS];
+    int count = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS, timeout_ms);
+    while (count > 0) {
+      for (int j = 0; j < count; j++) {
+        update(events[j]);
+      }
+      // there might be more events
+      if (count < EPOLL_MAX_EVENTS) break;
+      count = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS, 0);
+    }
+  }
+
+ protected:
+  int port = 23;
+  int listen_fd = -1;
+  int epoll_fd = -1;
+  bool is_accept_ready = false;
+  /// slots of the sockets which got ready: duplicates are possible
+  Vector<int> ready_slots;
+
+  /// Updates the readiness from the event
+  void update(epoll_event& event) {
+    EpollSocket* socket = (EpollSocket*)event.data.ptr;
+    if (socket == nullptr) {
+      is_accept_ready = true;
+      return;
+    }
+    if (event.events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+      // recv() reports the end of the connection after the remaining data
+      socket->is_readable = true;
+    }
+    if (event.events & EPOLLIN) socket->is_readable = true;
+    if (event.events & EPOLLOUT) socket->is_writable = true;
+    if (socket->slot >= 0) ready_slots.push_back(socket->slot);
+  }
+};
+
+/// The TinyTelnetServer waits for socket events instead of sleeping
+inline void waitForClients(EpollServer& server, int timeout_ms) {
+  server.wait(timeout_ms);
+}
+
+/// The TinyTelnetServer only serves the sessions which got ready
+inline void bindClient(EpollServer& server, EpollClient& client, int slot) {
+  client.setSlot(slot);
+}
+
+/// Reports the session slots of the sockets which got ready
+template <class Callback>
+inline bool readyClients(EpollServer& server, Callback callback) {
+  return server.readyClients(callback);
+}
+
+}  // namespace telnet
+
+#endif
@@ -0,0 +1,230 @@
+#pragma once
+#include "TinyTelnetServerConfig.h"
+#include "Utils/Logger.h"
+
+namespace telnet {
+
+/**
+ * @brief Streaming telnet protocol (RFC 854) state machine: the data is
+ * processed byte by byte, so commands can be anywhere in the stream and can
+ * be split over multiple reads. The commands are removed from the data and
+ * the negotiation requests are answered immediately.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class TelnetProtocol {
+ public:
+  // Telnet commands
+  static const uint8_t SE = 240;
+  static const uint8_t NOP = 241;
+  static const uint8_t BRK = 243;
+  static const uint8_t IP = 244;
+  static const uint8_t AO = 245;
+  static const uint8_t AYT = 246;
+  static const uint8_t SB = 250;
+  static const uint8_t WILL = 251;
+  static const uint8_t WONT = 252;
+  static const uint8_t DO = 253;
+  static const uint8_t DONT = 254;
+  static const uint8_t IAC = 255;
+  static const uint8_t ABORT = 238;
+  static const uint8_t SUSP = 237;
+  static const uint8_t XEOF = 236;
+
+  // Telnet options:
+  // 0	BINARY	Binary transmission
+  // 1	ECHO	Remote echo
+  // 3	SUPPRESS-GA	Suppress "Go Ahead"
+  // 24	TERMINAL-TYPE	Terminal type (e.g., xterm)
+  // 31	NAWS	Negotiate About Window Size
+  // 32	TERMINAL-SPEED	Terminal speed info
+  // 33	REMOTE-FLOW-CONTROL	Flow control settings
+  // 34	LINEMODE	Line-oriented mode
+  // 36	ENVIRONMENT	Send environment variables
+  static const uint8_t ECHO = 1;
+  static const uint8_t SUPPRESS_GA = 3;
+  static const uint8_t STATUS = 5;
+  static const uint8_t LINEMODE = 34;
+
+  /// Resets the state for a new connection
+  void reset() {
+    state = State::Data;
+    sb_len = 0;
+    is_interrupted = false;
+    is_character_mode = false;
+  }
+
+  /// Requests the character mode: the server echos the input, so that it
+  /// can edit the line (e.g. complete it with TAB)
+  void requestCharacterMode(Print& out) {
+    is_character_mode = true;
+    uint8_t request[6] = {IAC, WILL, ECHO, IAC, WILL, SUPPRESS_GA};
+    out.write(request, sizeof(request));
+  }
+
+  /// Returns true if we have requested the character mode
+  bool isCharacterMode() { return is_character_mode; }
+
+  /// Removes the telnet commands from the data (in place) and answers them
+  /// via out: returns the number of remaining data bytes
+  int filter(uint8_t* data, int len, Print& out) {
+    int result = 0;
+    for (int j = 0; j < len; j++) {
+      int value = process(data[j], out);
+      if (value >= 0) data[result++] = value;
+    }
+    return result;
+  }
+
+  /// Processes a single byte: returns the data byte or -1 if the byte is
+  /// part of a telnet command
+  int process(uint8_t value, Print& out) {
+    switch (state) {
+      case State::Data:
+        if (value == IAC) {
+          state = State::Command;
+          return -1;
+        }
+        if (value == '\r') state = State::CR;
+        return value;
+
+      case State::CR:
+        state = State::Data;
+        // CR NUL is a carriage return w/o line feed: we treat it as end of line
+        if (value == 0) return '\n';
+        return process(value, out);
+
+      case State::Command:
+        state = State::Data;
+        switch (value) {
+          case IAC:
+            // escaped 255 data byte
+            return IAC;
+          case DO:
+          case DONT:
+          case WILL:
+          case WONT:
+            verb = value;
+            state = State::Option;
+            break;
+          case SB:
+            sb_len = 0;
+            state = State::Subnegotiation;
+            break;
+          case IP:
+          case BRK:
+          case ABORT:
+          case SUSP:
+          case XEOF:
+            // Ctrl-C/Ctrl-Z close the session
+            TELNET_LOGD("telnet cmd: %d -> interrupt", value);
+            is_interrupted = true;
+            break;
+          case AYT:
+            out.println("[yes]");
+            break;
+          default:
+            TELNET_LOGD("telnet cmd: %d ignored", value);
+            break;
+        }
+        return -1;
+
+      case State::Option:
+        state = State::Data;
+        processOption(verb, value, out);
+        return -1;
+
+      case State::Subnegotiation:
+        if (value == IAC) {
+          state = State::SubnegotiationIAC;
+        } else if (sb_len < (int)sizeof(sb_data)) {
+          sb_data[sb_len++] = value;
+        }
+        return -1;
+
+      case State::SubnegotiationIAC:
+        if (value == SE) {
+          state = State::Data;
+          processSubnegotiation(out);
+        } else {
+          // IAC IAC in the subnegotiation data is an escaped 255
+          state = State::Subnegotiation;
+          if (value == IAC && sb_len < (int)sizeof(sb_data)) {
+            sb_data[sb_len++] = value;
+          }
+        }
+        return -1;
+    }
+    return -1;
+  }
+
+  /// Returns true if the client requested to interrupt the session
+  /// (e.g. with Ctrl-C)
+  bool isInterrupted() { return is_interrupted; }
+
+  /// Converts the telnet command to a string
+  static const char* controlStr(int cmd) {
+    if (cmd == DO) return "DO";
+    if (cmd == DONT) return "DONT";
+    if (cmd == WILL) return "WILL";
+    if (cmd == WONT) return "WONT";
+    if (cmd == SB) return "SB";  // Start subnegotiation
+
+    static char str[30];
+    snprintf(str, sizeof(str), "Unknown (%d)", cmd);
+    return str;
+  }
+
+ protected:
+  enum class State {
+    Data,
+    CR,
+    Command,
+    Option,
+    Subnegotiation,
+    SubnegotiationIAC
+  };
+  State state = State::Data;
+  uint8_t verb = 0;
+  uint8_t sb_data[16];
+  int sb_len = 0;
+  bool is_interrupted = false;
+  bool is_character_mode = false;
+
+  /// Answers a DO, DONT, WILL or WONT request
+  void processOption(uint8_t cmd, uint8_t option, Print& out) {
+    TELNET_LOGD("telnet cmd:%s %d", controlStr(cmd), option);
+    uint8_t reply[3] = {IAC, 0, option};
+    if (cmd == DO) {
+      // our own character mode request must not be confirmed again
+      if (is_character_mode && (option == ECHO || option == SUPPRESS_GA)) {
+        return;
+      }
+      // DO -> WILL or WONT
+      reply[1] = option == STATUS ? WONT : WILL;
+    } else if (cmd == WILL) {
+      // WILL -> DO or DONT: accept line mode negotiation unless we edit the
+      // line ourself
+      bool is_linemode = option == LINEMODE && !is_character_mode;
+      reply[1] = (option == SUPPRESS_GA || is_linemode) ? DO : DONT;
+    } else {
+      // DONT and WONT must not be confirmed again
+      return;
+    }
+    out.write(reply, sizeof(reply));
+    TELNET_LOGD("-> reply:%s %d", controlStr(reply[1]), option);
+  }
+
+  /// Answers a completed subnegotiation
+  void processSubnegotiation(Print& out) {
+    if (sb_len > 0 && sb_data[0] == LINEMODE) {
+      // Acknowledges only MODE_EDIT accepted
+      uint8_t tmp[7] = {IAC, SB, LINEMODE, 1, 1, IAC, SE};
+      TELNET_LOGD("-> reply %d (len=%d)", tmp[2], (int)sizeof(tmp));
+      out.write(tmp, sizeof(tmp));
+      out.println("> Welcome to TinyTelnetServer");
+    }
+  }
+};
+
+}  // namespace telnet
@@ -1,10 +1,130 @@
 #pragma once
+#include "Utils/ArenaAllocator.h"
+#include "Utils/ArgSchema.h"
+#include "Utils/Arguments.h"
+#include "Utils/CommandStats.h"
 #include "Utils/Logger.h"
+#include "Utils/PrefixTrie.h"
+#include "Utils/RingBuffer.h"
 #include "Utils/Str.h"
 #include "Utils/Vector.h"
 
 namespace telnet {
 
+class TinySerialServer;
+
+/// Result of a single step of a resumable command
+enum class StepResult { Continue, Done, Error };
+
+/**
+ * @brief State of a resumable command which is kept per session between the
+ * calls of the step function.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct CommandState {
+  /// command name
+  telnet::Str cmd;
+  /// command parameters
+  telnet::Vector<telnet::Str> parameters;
+  /// number of previous calls: 0 for the first call
+  int step = 0;
+  /// user defined data
+  void* data = nullptr;
+  /// context which has been registered with the command
+  void* context = nullptr;
+  /// optional callback to release the user defined data
+  void (*cleanup)(CommandState& state) = nullptr;
+  /// step function of the running command
+  StepResult (*callback)(CommandState& state, Print& out,
+                         TinySerialServer* self) = nullptr;
+#if USE_COMMAND_STATS
+  /// statistics of the running command: time and bytes of all steps
+  int stats_id = -1;
+  uint32_t stats_us = 0;
+  uint32_t stats_bytes = 0;
+#endif
+
+  /// Returns true if a command is running
+  bool isActive() { return callback != nullptr; }
+
+  /// Ends the running command and releases the user defined data
+  void end() {
+    if (cleanup != nullptr) cleanup(*this);
+    cleanup = nullptr;
+    callback = nullptr;
+    data = nullptr;
+    context = nullptr;
+    step = 0;
+#if USE_COMMAND_STATS
+    stats_id = -1;
+    stats_us = 0;
+    stats_bytes = 0;
+#endif
+  }
+};
+
+/**
+ * @brief Collects the candidates for the completion of a word: we determine
+ * the number of candidates and their longest common prefix, which is the
+ * completed word.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class Completion {
+ public:
+  /// Defines the word to be completed and the buffer for the result
+  Completion(const char* word, char* result, int max_len) {
+    p_word = word;
+    p_result = result;
+    this->max_len = max_len;
+    p_result[0] = 0;
+  }
+
+  /// Adds a candidate: it is ignored if it does not start with the word
+  void add(const char* candidate) {
+    if (!StrView(candidate).startsWithIgnoreCase(p_word)) return;
+    if (p_list != nullptr) {
+      p_list->print(candidate);
+      p_list->print("  ");
+    }
+    if (count++ == 0) {
+      strncpy(p_result, candidate, max_len - 1);
+      p_result[max_len - 1] = 0;
+      return;
+    }
+    // keep the common prefix
+    int j = 0;
+    while (p_result[j] != 0 && toLower(p_result[j]) == toLower(candidate[j])) {
+      j++;
+    }
+    p_result[j] = 0;
+  }
+
+  /// Provides the word which is completed
+  const char* word() { return p_word; }
+
+  /// Provides the completed word: the common prefix of all candidates
+  const char* result() { return p_result; }
+
+  /// Number of candidates
+  int size() { return count; }
+
+  /// If defined, all candidates are printed
+  void setList(Print* out) { p_list = out; }
+
+ protected:
+  const char* p_word;
+  char* p_result;
+  int max_len;
+  int count = 0;
+  Print* p_list = nullptr;
+
+  static char toLower(char c) {
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+  }
+};
+
 /**
  * @brief A simple serial server for Arduino. Call the addCommand method to
  * register your commands.
@@ -14,6 +134,117 @@ namespace telnet {
 
 class TinySerialServer {
  public:
+  /// command which gets the parameters w/o copying them
+  using Handler = bool (*)(const Arguments& args, Print& out,
+                           TinySerialServer* self);
+  /// command which gets the parameters and the registered context
+  using ContextHandler = bool (*)(const Arguments& args, Print& out,
+                                  void* context);
+  /// command which gets a copy of the parameters
+  using Callback = bool (*)(telnet::Str& cmd,
+                            telnet::Vector<telnet::Str> parameters, Print& out,
+                            TinySerialServer* self);
+  /// step function of a resumable command
+  using Step = StepResult (*)(CommandState& state, Print& out,
+                              TinySerialServer* self);
+  /// provides the candidates for the completion of a parameter
+  using Completer = void (*)(const char* cmd, Completion& completion,
+                             void* context);
+
+  /// TinySerialServer command: the constructors are constexpr, so you can
+  /// define a static command table which is registered with addCommands()
+  struct Command {
+    constexpr Command() : Command("", "", nullptr, nullptr, nullptr, nullptr) {}
+    constexpr Command(const char* cmd, Handler handler,
+                      const char* parameter_help = "")
+        : Command(cmd, parameter_help, handler, nullptr, nullptr, nullptr) {}
+    constexpr Command(const char* cmd, ContextHandler handler, void* context,
+                      const char* parameter_help = "")
+        : Command(cmd, parameter_help, nullptr, handler, nullptr, nullptr,
+                  context) {}
+    constexpr Command(const char* cmd, Callback callback,
+                      const char* parameter_help = "")
+        : Command(cmd, parameter_help, nullptr, nullptr, callback, nullptr) {}
+    constexpr Command(const char* cmd, Step step,
+                      const char* parameter_help = "")
+        : Command(cmd, parameter_help, nullptr, nullptr, nullptr, step) {}
+    constexpr Command(const char* cmd, Step step, void* context,
+                      const char* parameter_help = "")
+        : Command(cmd, parameter_help, nullptr, nullptr, nullptr, step,
+                  context) {}
+    /// command string
+    const char* cmd;
+    /// example/information for parameters
+    const char* parameter_help;
+    /// callback function which gets the parameters w/o copying them
+    Handler handler;
+    /// callback function which gets the parameters and the context
+    ContextHandler context_handler;
+    /// callback function which gets a copy of the parameters
+    Callback callback;
+    /// step function of resumable commands
+    Step step;
+    /// user defined context which is passed to the context_handler or
+    /// provided in the CommandState of the step function
+    void* context;
+    /// case insensitive hash of the command string
+    uint32_t hash;
+    /// command which gets the arguments converted by the schema
+    ArgSchema::Function typed = nullptr;
+    /// definition of the arguments of the typed command
+    const ArgSchema* schema = nullptr;
+    /// number of tokens which are consumed by a call if the commands per
+    /// second are limited
+    uint16_t weight = 1;
+    /// the command can be executed by several worker threads at the same
+    /// time: all other commands are executed one after the other
+    bool is_thread_safe = false;
+#if USE_COMMAND_STATS
+    /// index of the statistics which is assigned when a dynamic command is
+    /// registered: -1 for the entries of the (constant) command tables
+    int16_t stats_id = -1;
+#endif
+
+    /// Provides a copy with the indicated weight: e.g. for table entries
+    /// TinySerialServer::Command("ls", cmd_ls).withWeight(10)
+    constexpr Command withWeight(uint16_t weight) const {
+      return Command(*this, weight, is_thread_safe);
+    }
+
+    /// Provides a copy which is marked as thread safe: e.g. for table
+    /// entries TinySerialServer::Command("ping", cmd_ping).withThreadSafe()
+    constexpr Command withThreadSafe(bool thread_safe = true) const {
+      return Command(*this, weight, thread_safe);
+    }
+
+   protected:
+    constexpr Command(const Command& other, uint16_t weight,
+                      bool is_thread_safe)
+        : cmd(other.cmd),
+          parameter_help(other.parameter_help),
+          handler(other.handler),
+          context_handler(other.context_handler),
+          callback(other.callback),
+          step(other.step),
+          context(other.context),
+          hash(other.hash),
+          typed(other.typed),
+          schema(other.schema),
+          weight(weight),
+          is_thread_safe(is_thread_safe) {}
+    constexpr Command(const char* cmd, const char* parameter_help,
+                      Handler handler, ContextHandler context_handler,
+                      Callback callback, Step step, void* context = nullptr)
+        : cmd(cmd),
+          parameter_help(parameter_help),
+          handler(handler),
+          context_handler(context_handler),
+          callback(callback),
+          step(step),
+          context(context),
+          hash(hashCommand(cmd)) {}
+  };
+
   /// Enpty constructor
   TinySerialServer() = default;
   /// Default constructor that expects a Stream reference
@@ -31,93 +262,603 @@ class TinySerialServer {
   /// Stop the server
   virtual void end() { is_active = false; }
 
-  /// Add a new command
-  virtual void addCommand(const char* cmd,
-                          bool (*cb)(telnet::Str& cmd,
-                                     telnet::Vector<telnet::Str> parameters,
-                                     Print& out, TinySerialServer* self),
+  /// Add a new command: the parameters point into the input line, so no
+  /// heap is needed to call it
+  virtual void addCommand(const char* cmd, Handler handler,
                           const char* parameter_help = "") {
+    Command command(cmd, handler, parameter_help);
+    addCommand(command);
+  }
+
+  /// Add a new command which gets the indicated context: this way you can
+  /// e.g. pass on an object
+  virtual void addCommand(const char* cmd, ContextHandler handler,
+                          void* context, const char* parameter_help = "") {
+    Command command(cmd, handler, context, parameter_help);
+    addCommand(command);
+  }
+
+  /// Add a function object (e.g. a lambda with captures) as command: it must
+  /// provide bool operator()(const Arguments&, Print&) and stay valid while
+  /// the server is running because we only keep a pointer to it
+  template <class T>
+  void addCommand(const char* cmd, T& functor,
+                  const char* parameter_help = "") {
+    Command command(cmd, callFunctor<T>, &functor, parameter_help);
+    addCommand(command);
+  }
+
+  /// Add a new command which gets the arguments validated and converted to
+  /// the struct T which is described by the schema: invalid arguments are
+  /// reported w/o calling the command. The schema must stay valid.
+  template <class T>
+  void addCommand(const char* cmd,
+                  bool (*handler)(const T& args, Print& out, void* context),
+                  const ArgSchema& schema, void* context = nullptr,
+                  const char* parameter_help = "") {
     Command command;
     command.cmd = cmd;
-    command.callback = cb;
+    command.hash = hashCommand(cmd);
     command.parameter_help = parameter_help;
-    commands.push_back(command);
+    command.context = context;
+    command.typed = reinterpret_cast<ArgSchema::Function>(handler);
+    command.schema = &schema;
+    addCommand(command);
+  }
+
+  /// Add a new command which gets a copy of the parameters
+  virtual void addCommand(const char* cmd, Callback cb,
+                          const char* parameter_help = "") {
+    Command command(cmd, cb, parameter_help);
+    addCommand(command);
+  }
+
+  /// Add a new resumable command: the step function is called repeatedly for
+  /// a limited time slice in each processCommand() until it returns
+  /// StepResult::Done or StepResult::Error.
+  virtual void addCommand(const char* cmd, Step step,
+                          const char* parameter_help = "") {
+    Command command(cmd, step, parameter_help);
+    addCommand(command);
+  }
+
+  /// Add a new resumable command which finds the indicated context in the
+  /// CommandState
+  virtual void addCommand(const char* cmd, Step step, void* context,
+                          const char* parameter_help = "") {
+    Command command(cmd, step, context, parameter_help);
+    addCommand(command);
+  }
+
+  /// Registers a static command table w/o copying it: the table must stay
+  /// valid, so best define it as constexpr array:
+  ///
+  /// constexpr TinySerialServer::Command table[] = {
+  ///     {"ping", ping, ": replys with pong"}, ...};
+  /// server.addCommands(table);
+  template <int N>
+  bool addCommands(const Command (&table)[N]) {
+    return addCommands(table, N);
+  }
+
+  /// Registers a static command table with the indicated number of entries
+  bool addCommands(const Command* table, int size) {
+    if (command_table_count >= MAX_COMMAND_TABLES) {
+      TELNET_LOGE("max command tables reached: %d", MAX_COMMAND_TABLES);
+      return false;
+    }
+    command_tables[command_table_count].commands = table;
+    command_tables[command_table_count].size = size;
+#if USE_COMMAND_STATS
+    table_stats[command_table_count].resize(size, CommandStats());
+#endif
+    command_table_count++;
+    is_trie_valid = false;
+    return true;
+  }
+
+  /// Case insensitive FNV-1a hash of the command name
+  static constexpr uint32_t hashCommand(const char* cmd,
+                                        uint32_t hash = 2166136261u) {
+    return *cmd == 0
+               ? hash
+               : hashCommand(cmd + 1,
+                             (hash ^ (uint8_t)toLowerAscii(*cmd)) * 16777619u);
+  }
+
+  static constexpr char toLowerAscii(char c) {
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
   }
 
-  /// proccess the next command: call in loop()
+  /// proccess the next commands: call in loop(). We never block: incomplete
+  /// lines are kept until the rest has arrived. All complete lines are
+  /// processed up to the max lines per pass.
   virtual bool processCommand() {
     if (!is_active) return false;
     Stream& stream = *p_stream;
-    TELNET_LOGI("available: %d bytes", stream.available());
-    char input[max_input_buffer_size];
-    int len = readLine(stream, input, max_input_buffer_size);
-    return processCommand(input, stream);
+    readInput(stream, input);
+    if (state.isActive()) {
+      resumeCommand(state, stream);
+      return true;
+    }
+    bool result = false;
+    char line[max_input_buffer_size];
+    p_command_state = &state;
+    for (int lines = 0; lines < max_lines_per_pass; lines++) {
+      int len = readLine(input, line, max_input_buffer_size);
+      if (len < 0) {
+        // we might have stopped reading because the buffer was full
+        if (readInput(stream, input) == 0) break;
+        len = readLine(input, line, max_input_buffer_size);
+        if (len < 0) break;
+      }
+      if (processCommand(line, stream)) result = true;
+      if (state.isActive()) break;
+    }
+    p_command_state = nullptr;
+    return result;
   }
 
   /// Defines the input buffer size: default is MAX_INPUT_BUFFER_SIZE (256)
   void setMaxInputBufferSize(int size) { max_input_buffer_size = size; }
 
+  /// Defines the max number of lines which are processed per client in one
+  /// call of processCommand(): default is MAX_LINES_PER_PASS
+  void setMaxLinesPerPass(int lines) {
+    max_lines_per_pass = lines > 0 ? lines : 1;
+  }
+
+  /// Defines the max time in ms that a resumable command is executed in one
+  /// processCommand(): default is STEP_TIME_SLICE_MS
+  void setTimeSlice(int ms) { step_time_slice = ms; }
+
   /// Defines a reference object which can be used in the callback
   void setReference(void* reference) { p_reference = reference; }
 
   /// Returns the reference object which can be used in the callback
   void* getReference() { return p_reference; }
 
+  /// Activates/deactivates the execution of commands by an unambiguous
+  /// abbreviation (e.g. sys.v for sys.version): default is USE_ABBREVIATIONS
+  void setAbbreviations(bool active) { is_abbreviations = active; }
+
+  /// Defines the provider for the completion of the parameters (e.g. file
+  /// names): the commands are completed by the server
+  void setCompleter(Completer completer, void* context = nullptr) {
+    this->completer = completer;
+    completer_context = context;
+  }
+
+  /// Completes the last word of the (incomplete) line: the completed word is
+  /// the common prefix of all candidates and the result is the line with the
+  /// completed word. If the list is defined, all candidates are printed.
+  /// Returns the number of candidates.
+  int complete(const char* line, char* result, int max_len,
+               Print* list = nullptr) {
+    // determine the last word
+    int word = 0;
+    for (int j = 0; line[j] != 0; j++) {
+      if (line[j] == ' ' || line[j] == '(' || line[j] == ',') word = j + 1;
+    }
+    if (word >= max_len) return 0;
+    strncpy(result, line, word);
+    Completion completion(line + word, result + word, max_len - word);
+    completion.setList(list);
+    if (word == 0) {
+      commandTrie().forEach(line, [&](const Command* command) {
+        if (isAscii(command->cmd[0])) completion.add(command->cmd);
+      });
+    } else if (completer != nullptr) {
+      // provide the command name to the completer
+      int len = strcspn(line, " (");
+      char cmd[len + 1];
+      strncpy(cmd, line, len);
+      cmd[len] = 0;
+      completer(cmd, completion, completer_context);
+    }
+    if (completion.size() == 0) {
+      strncpy(result, line, max_len - 1);
+      result[max_len - 1] = 0;
+    }
+    return completion.size();
+  }
+
+  /// Defines the number of tokens which are consumed by a call of the
+  /// command if the commands per second are limited: this is only possible
+  /// for commands which have been added with addCommand(); use
+  /// Command::withWeight() in command tables.
+  bool setCommandWeight(const char* cmd, uint16_t weight) {
+    for (auto& command : commands) {
+      if (StrView(command.cmd).equalsIgnoreCase(cmd)) {
+        command.weight = weight;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Marks the command as thread safe, so that it can be executed by several
+  /// worker threads at the same time: this is only possible for commands
+  /// which have been added with addCommand(); use Command::withThreadSafe()
+  /// in command tables.
+  bool setCommandThreadSafe(const char* cmd, bool thread_safe = true) {
+    for (auto& command : commands) {
+      if (StrView(command.cmd).equalsIgnoreCase(cmd)) {
+        command.is_thread_safe = thread_safe;
+        return true;
+      }
+    }
+    return false;
+  }
+
   /// Defines an error callback
-  void setErrorCallback(bool (*cb)(telnet::Str& cmd,
-                                   telnet::Vector<telnet::Str> parameters,
-                                   Print& out, TinySerialServer* self)) {
-    error_callback = cb;
+  void setErrorCallback(Callback cb) { error_callback = cb; }
+
+  /// Defines an error callback which gets the parameters w/o copying them
+  void setErrorCallback(Handler cb) { error_handler = cb; }
+
+#if USE_COMMAND_STATS
+  /// Provides the statistics of the indicated command or nullptr if the
+  /// command does not exist
+  const CommandStats* getStats(const char* cmd) {
+    const Command* command = findCommand(cmd);
+    return command == nullptr ? nullptr : statsOf(statsId(command));
+  }
+
+  /// Resets the statistics of all commands
+  void resetStats() {
+    for (auto& stats : command_stats) stats.clear();
+    for (int t = 0; t < command_table_count; t++) {
+      for (auto& stats : table_stats[t]) stats.clear();
+    }
+  }
+
+  /// Prints the statistics of all called commands: register it with
+  /// server.addCommand("stats", TinySerialServer::cmd_stats);
+  /// Use "stats reset" to clear the values.
+  static bool cmd_stats(const Arguments& args, Print& out,
+                        TinySerialServer* self) {
+    if (args.size() > 0) {
+      if (!args[0].equalsIgnoreCase("reset")) {
+        out.println("Usage: stats [reset]");
+        return false;
+      }
+      self->resetStats();
+      out.println("Statistics reset");
+      return true;
+    }
+    out.println("cmd\tcalls\terrors\tavg_us\tmax_us\tbytes");
+    for (int j = 0; j < self->commands.size(); j++) {
+      printStats(self->commands[j], self->command_stats[j], out);
+    }
+    for (int t = 0; t < self->command_table_count; t++) {
+      const CommandTable& table = self->command_tables[t];
+      for (int j = 0; j < table.size; j++) {
+        printStats(table.commands[j], self->table_stats[t][j], out);
+      }
+    }
+    out.println();
+    return true;
+  }
+#endif
+
+#if USE_ALLOCATOR_STATS
+  /// Adds an allocator (e.g. a PoolAllocator) to the output of the mem
+  /// command: the name and the allocator must stay valid
+  void addAllocatorStats(const char* name, Allocator& allocator) {
+    NamedAllocator named{name, &allocator};
+    allocators.push_back(named);
   }
 
+  /// Prints the statistics of the allocators: register it with
+  /// server.addCommand("mem", TinySerialServer::cmd_mem);
+  static bool cmd_mem(const Arguments& args, Print& out,
+                      TinySerialServer* self) {
+    out.println("allocator\tlive\tpeak\tallocs\tfrees\tfailed");
+    printAllocatorStats("default", DefaultAllocator, out);
+    printAllocatorStats("arena", self->arena, out);
+    for (auto& named : self->allocators) {
+      printAllocatorStats(named.name, *named.allocator, out);
+    }
+#if defined(ESP32) && defined(ARDUINO)
+    out.print("heap free: ");
+    out.print(ESP.getFreeHeap());
+    out.print(" min free: ");
+    out.print(ESP.getMinFreeHeap());
+    out.print(" max block: ");
+    out.println(ESP.getMaxAllocHeap());
+    out.print("psram free: ");
+    out.println(ESP.getFreePsram());
+#endif
+    out.println();
+    return true;
+  }
+#endif
+
  protected:
   int max_input_buffer_size = MAX_INPUT_BUFFER_SIZE;
+  int max_lines_per_pass = MAX_LINES_PER_PASS;
+  int step_time_slice = STEP_TIME_SLICE_MS;
   Stream* p_stream = nullptr;
+  RingBuffer input;
+  CommandState state;
+  /// state which is used when a resumable command is started
+  CommandState* p_command_state = nullptr;
   bool is_active = false;
   void* p_reference = nullptr;
-  bool (*error_callback)(telnet::Str& cmd,
-                         telnet::Vector<telnet::Str> parameters, Print& out,
-                         TinySerialServer* self) = nullptr;
+  Callback error_callback = nullptr;
+  Handler error_handler = nullptr;
+  Completer completer = nullptr;
+  void* completer_context = nullptr;
+  bool is_abbreviations = USE_ABBREVIATIONS;
+  /// memory for the short lived copies of the legacy callbacks
+  ArenaAllocator arena;
+#if USE_ALLOCATOR_STATS
+  struct NamedAllocator {
+    const char* name;
+    Allocator* allocator;
+  };
+  telnet::Vector<NamedAllocator> allocators;
+#endif
 
-  /// TinySerialServer command
-  struct Command {
-    /// command string
-    const char* cmd;
-    /// example/information for parameters
-    const char* parameter_help = "";
-    /// callback function
-    bool (*callback)(telnet::Str& cmd, telnet::Vector<telnet::Str> parameters,
-                     Print& out, TinySerialServer* self);
+  /// registered command tables
+  struct CommandTable {
+    const Command* commands = nullptr;
+    int size = 0;
   };
 
   telnet::Vector<Command> commands;
+  CommandTable command_tables[MAX_COMMAND_TABLES];
+  int command_table_count = 0;
+  /// prefix tree of all command names which is built on the first use
+  PrefixTrie<const Command*> command_trie;
+  bool is_trie_valid = false;
+  /// open addressing hash table with the index of the commands (-1 = empty)
+  telnet::Vector<int16_t> command_index;
+#if USE_COMMAND_STATS
+  /// statistics of the dynamic commands and of the command tables
+  telnet::Vector<CommandStats> command_stats;
+  telnet::Vector<CommandStats> table_stats[MAX_COMMAND_TABLES];
+  /// just in case a command is not found
+  CommandStats unknown_stats;
+#endif
 
-  /// Finds a command by name
-  Command* findCommand(const char* cmd) {
-    for (auto& command : commands) {
-      if (strcmp(command.cmd, cmd) == 0) {
-        return &command;
+  /// Registers the command: if a command with the same name (ignoring the
+  /// case) exists already, the first one is used
+  void addCommand(Command& command) {
+#if USE_COMMAND_STATS
+    command.stats_id = command_stats.size();
+    command_stats.push_back(CommandStats());
+#endif
+    commands.push_back(command);
+    is_trie_valid = false;
+    // keep the load factor below 50%
+    if (commands.size() * 2 > command_index.size()) {
+      rebuildCommandIndex();
+    } else {
+      insertCommandIndex(commands.size() - 1);
+    }
+  }
+
+  /// Rebuilds the hash table with a size which is a power of 2
+  void rebuildCommandIndex() {
+    int size = 16;
+    while (size < commands.size() * 2) size *= 2;
+    command_index.resize(size);
+    for (int j = 0; j < size; j++) command_index[j] = -1;
+    for (int j = 0; j < commands.size(); j++) insertCommandIndex(j);
+  }
+
+  /// Adds the command with the indicated index to the hash table
+  void insertCommandIndex(int idx) {
+    const char* name = commands[idx].cmd;
+    int mask = command_index.size() - 1;
+    for (int pos = commands[idx].hash & mask;; pos = (pos + 1) & mask) {
+      int existing = command_index[pos];
+      if (existing < 0) {
+        command_index[pos] = idx;
+        return;
+      }
+      if (StrView(commands[existing].cmd).equalsIgnoreCase(name)) return;
+    }
+  }
+
+  /// Finds a command by name ignoring the case: the dynamic commands are
+  /// checked before the static command tables
+  const Command* findCommand(const char* cmd) {
+    uint32_t hash = hashCommand(cmd);
+    if (command_index.size() > 0) {
+      int mask = command_index.size() - 1;
+      for (int pos = hash & mask;; pos = (pos + 1) & mask) {
+        int idx = command_index[pos];
+        if (idx < 0) break;
+        if (commands[idx].hash == hash &&
+            StrView(commands[idx].cmd).equalsIgnoreCase(cmd)) {
+          return &commands[idx];
+        }
+      }
+    }
+    // the tables are small, so we just compare the precalculated hash
+    for (int t = 0; t < command_table_count; t++) {
+      const CommandTable& table = command_tables[t];
+      for (int j = 0; j < table.size; j++) {
+        if (table.commands[j].hash == hash &&
+            StrView(table.commands[j].cmd).equalsIgnoreCase(cmd)) {
+          return &table.commands[j];
+        }
       }
     }
     return nullptr;
   }
 
+  /// Provides the prefix tree of all commands: it is rebuilt after new
+  /// commands have been added
+  PrefixTrie<const Command*>& commandTrie() {
+    if (!is_trie_valid) {
+      command_trie.clear();
+      // same priority as in findCommand()
+      for (auto& command : commands) command_trie.add(command.cmd, &command);
+      for (int t = 0; t < command_table_count; t++) {
+        const CommandTable& table = command_tables[t];
+        for (int j = 0; j < table.size; j++) {
+          command_trie.add(table.commands[j].cmd, &table.commands[j]);
+        }
+      }
+      is_trie_valid = true;
+    }
+    return command_trie;
+  }
+
+  /// Finds the command which is the only one that starts with the indicated
+  /// abbreviation
+  const Command* findAbbreviation(const char* cmd) {
+    const Command* result = nullptr;
+    if (!commandTrie().findUnique(cmd, result)) return nullptr;
+    TELNET_LOGI("Abbreviation: %s -> %s", cmd, result->cmd);
+    return result;
+  }
+
+#if USE_COMMAND_STATS
+  /// Identifies the statistics of the command: the index which was stored
+  /// in the dynamic command or (table + 1) << 16 | index for the command
+  /// tables
+  int statsId(const Command* command) {
+    if (command->stats_id >= 0) return command->stats_id;
+    for (int t = 0; t < command_table_count; t++) {
+      const CommandTable& table = command_tables[t];
+      if (command >= table.commands && command < table.commands + table.size) {
+        return (t + 1) << 16 | (command - table.commands);
+      }
+    }
+    return -1;
+  }
+
+  /// Provides the statistics for the id which was determined by statsId()
+  CommandStats* statsOf(int id) {
+    if (id < 0) return &unknown_stats;
+    int table = id >> 16;
+    int idx = id & 0xFFFF;
+    return table == 0 ? &command_stats[idx] : &table_stats[table - 1][idx];
+  }
+
+  /// Prints a line with the statistics of a command which has been called
+  static void printStats(const Command& command, const CommandStats& stats,
+                         Print& out) {
+    if (stats.count == 0) return;
+    out.print(command.cmd);
+    out.print("\t");
+    out.print(stats.count);
+    out.print("\t");
+    out.print(stats.errors);
+    out.print("\t");
+    out.print(stats.averageUs());
+    out.print("\t");
+    out.print(stats.max_us);
+    out.print("\t");
+    out.println(stats.bytes);
+    // histogram: lower limit in us and number of calls of the used buckets
+    out.print("  us:");
+    for (int b = 0; b < COMMAND_STATS_BUCKETS; b++) {
+      if (stats.histogram[b] == 0) continue;
+      out.print(" >=");
+      out.print(CommandStats::bucketStartUs(b));
+      out.print(":");
+      out.print(stats.histogram[b]);
+    }
+    out.println();
+  }
+#endif
+
+  /// Provides the weight of the command of the line: unknown commands
+  /// have a weight of 1
+  int commandWeight(const char* line) {
+    const Command* command = findLineCommand(line);
+    return command == nullptr ? 1 : command->weight;
+  }
+
+  /// Determines the command of the line w/o parsing the parameters
+  const Command* findLineCommand(const char* line) {
+    int len = strcspn(line, " \t(");
+    char cmd[len + 1];
+    strncpy(cmd, line, len);
+    cmd[len] = 0;
+    return lookupCommand(cmd);
+  }
+
+  /// Finds the command by its name or by an unambiguous abbreviation
+  const Command* lookupCommand(const char* cmd) {
+    const Command* command = findCommand(cmd);
+    if (command == nullptr && is_abbreviations) {
+      command = findAbbreviation(cmd);
+    }
+    return command;
+  }
+
+#if USE_ALLOCATOR_STATS
+  /// Prints a line with the statistics of an allocator
+  static void printAllocatorStats(const char* name, Allocator& allocator,
+                                  Print& out) {
+    AllocatorStats& stats = allocator.getStats();
+    out.print(name);
+    out.print("\t");
+    out.print((unsigned long)stats.live_bytes);
+    out.print("\t");
+    out.print((unsigned long)stats.peak_bytes);
+    out.print("\t");
+    out.print(stats.allocations);
+    out.print("\t");
+    out.print(stats.releases);
+    out.print("\t");
+    out.println(stats.failures);
+    // histogram: upper limit of the requested size and number of requests
+    out.print("  size:");
+    for (int b = 0; b < ALLOCATOR_STATS_BUCKETS; b++) {
+      if (stats.histogram[b] == 0) continue;
+      out.print(b == ALLOCATOR_STATS_BUCKETS - 1 ? " >" : " <=");
+      out.print((unsigned long)AllocatorStats::bucketEnd(
+          b == ALLOCATOR_STATS_BUCKETS - 1 ? b - 1 : b));
+      out.print(":");
+      out.print(stats.histogram[b]);
+    }
+    out.println();
+  }
+#endif
+
+  /// Prints the name of the command if it is visible in the help
+  static void printCommandName(const Command& command, Print& out) {
+    if (isAscii(command.cmd[0])) {
+      out.print(command.cmd);
+      out.print("\t");
+    }
+  }
+
   /// help callback
-  static bool cmd_help(telnet::Str& cmd, telnet::Vector<telnet::Str> parameters,
-                       Print& out, TinySerialServer* self) {
-    if (parameters.size() == 0) {
+  static bool cmd_help(const Arguments& args, Print& out,
+                       TinySerialServer* self) {
+    if (args.size() == 0) {
       out.println("\nAvailable commands:");
       for (auto& command : self->commands) {
-        if (isAscii(command.cmd[0])) {
-          out.print(command.cmd);
-          out.print("\t");
+        printCommandName(command, out);
+      }
+      for (int t = 0; t < self->command_table_count; t++) {
+        const CommandTable& table = self->command_tables[t];
+        for (int j = 0; j < table.size; j++) {
+          // skip the entries which are hidden by a command with the same name
+          const Command& command = table.commands[j];
+          if (self->findCommand(command.cmd) == &command) {
+            printCommandName(command, out);
+          }
         }
       }
       out.println("\n");
     } else {
-      const char* help_cmd = parameters[0].c_str();
-      Command* command = self->findCommand(help_cmd);
-      if (command != nullptr && !StrView(command->parameter_help).isEmpty()) {
+      const char* help_cmd = args.c_str(0);
+      const Command* command = self->findCommand(help_cmd);
+      if (command == nullptr) {
+        out.print(">Command: ");
+        out.print(help_cmd);
+        out.println(": Unknown command");
+      } else if (!StrView(command->parameter_help).isEmpty()) {
         out.print(">Command: ");
         out.print(command->cmd);
         out.print(" ");
@@ -133,139 +874,288 @@ class TinySerialServer {
     return true;
   }
 
-  /// Reads a line delimited by '\n' from the Stream
-  int readLine(Stream& in, char* str, int max) {
-    memset(str, 0, max);
-    int index = 0;
-    if (in.available() > 0) {
-      index = in.readBytesUntil('\n', str, max);
-      str[index - 1] = '\0';  // null termination character
-      // special logic for Windows line endings
-      if (str[index - 2] == '\r') {
-        str[index - 2] = '\0';  // remove carriage return if present
-        index--;
-      }
+  /// Moves the available bytes from the stream into the buffer w/o blocking
+  int readInput(Stream& in, RingBuffer& buffer) {
+    if (buffer.size() != max_input_buffer_size) {
+      buffer.resize(max_input_buffer_size);
+    }
+    int result = 0;
+    uint8_t tmp[64];
+    int len;
+    while ((len = readAvailable(in, tmp, sizeof(tmp),
+                                buffer.availableForWrite())) > 0) {
+      buffer.write(tmp, len);
+      result += len;
+    }
+    return result;
+  }
+
+  /// Reads up to max bytes (and not more then limit) which are available
+  /// w/o blocking
+  int readAvailable(Stream& in, uint8_t* data, int max, int limit) {
+    int len = in.available();
+    if (len > limit) len = limit;
+    if (len > max) len = max;
+    if (len <= 0) return 0;
+    return in.readBytes(data, len);
+  }
+
+  /// Provides the next line delimited by '\n' from the buffer: returns -1 if
+  /// the line is not complete yet
+  int readLine(RingBuffer& in, char* str, int max) {
+    int pos = in.indexOf('\n');
+    if (pos < 0) {
+      // the line does not fit into the buffer: so we process what we have
+      if (!in.isFull()) return -1;
+      pos = in.available();
     }
-    return index - 1;
+    int len = pos < max - 1 ? pos : max - 1;
+    in.readBytes((uint8_t*)str, len);
+    // remove the rest of the line and the delimiter
+    in.consume(pos + 1 - len);
+    // special logic for Windows line endings
+    if (len > 0 && str[len - 1] == '\r') len--;
+    str[len] = '\0';
+    return len;
   }
 
   /// Processes the command and returns the result output via Client
   virtual bool processCommand(const char* input, Print& result) {
-    telnet::Str cmd;
-    telnet::Vector<telnet::Str> parameters;
-    parseCommand(input, cmd, parameters);
-    if (cmd.isEmpty()) {
+    char line[strlen(input) + 1];
+    strcpy(line, input);
+    return processCommand(line, result);
+  }
+
+  /// Processes the command line: it is tokenized in place, so the content is
+  /// changed
+  virtual bool processCommand(char* line, Print& result) {
+    Arguments args;
+    if (!args.parse(line)) {
       return false;
     }
-    bool ok = processCommand(cmd, parameters, result);
-    if (!ok && error_callback != nullptr) {
-      error_callback(cmd, parameters, result, this);
+    bool ok = processCommand(args, result);
+    if (!ok) reportError(args, result);
+    return ok;
+  }
+
+  /// Calls the error callbacks
+  void reportError(const Arguments& args, Print& out) {
+    if (error_handler != nullptr) error_handler(args, out, this);
+    if (error_callback != nullptr) {
+      callCallback(error_callback, args, out);
     }
+  }
+
+  /// Calls the function object which has been registered as context
+  template <class T>
+  static bool callFunctor(const Arguments& args, Print& out, void* context) {
+    return (*static_cast<T*>(context))(args, out);
+  }
+
+  /// Copies the parameters for the callbacks which keep them
+  static void copyParameters(const Arguments& args,
+                             telnet::Vector<telnet::Str>& parameters,
+                             Allocator& allocator = DefaultAllocator) {
+    parameters.clear();
+    parameters.reserve(args.size());
+    for (int j = 0; j < args.size(); j++) {
+      telnet::Str& parameter = parameters.emplace_back();
+      parameter.setAllocator(allocator);
+      parameter = args.c_str(j);
+    }
+  }
+
+  /// Passes undefined commands to the legacy processCommandUndefined()
+  static bool undefinedCallback(telnet::Str& cmd,
+                                telnet::Vector<telnet::Str> parameters,
+                                Print& out, TinySerialServer* self) {
+    return self->processCommandUndefined(cmd, parameters, out);
+  }
+
+  /// Arena for the copies of the legacy callbacks: nullptr to use the heap
+  virtual ArenaAllocator* commandArena() { return &arena; }
+
+  /// Calls a legacy callback with a copy of the arguments: the copy is
+  /// allocated in the arena which is reset when the callback has returned
+  bool callCallback(Callback callback, const Arguments& args, Print& out) {
+    ArenaAllocator* p_arena = commandArena();
+    Allocator& allocator =
+        p_arena != nullptr ? (Allocator&)*p_arena : DefaultAllocator;
+    size_t mark = p_arena != nullptr ? p_arena->mark() : 0;
+    bool result = false;
+    {
+      telnet::Str cmd;
+      cmd.setAllocator(allocator);
+      cmd = args.cmd();
+      telnet::Vector<telnet::Str> parameters(allocator);
+      copyParameters(args, parameters, allocator);
+      result = callback(cmd, parameters, out, this);
+    }
+    // callbacks might be nested, so we only release our own memory
+    if (p_arena != nullptr) p_arena->reset(mark);
+    return result;
+  }
+
+  /// process the command
+  bool processCommand(const Arguments& args, Print& result) {
+    return processCommand(lookupCommand(args.cmd()), args, result);
+  }
+
+  /// process the command which has been determined by lookupCommand()
+  bool processCommand(const Command* command, const Arguments& args,
+                      Print& result) {
+    if (command == nullptr) {
+      return processCommandUndefined(args, result);
+    }
+    if (command->step != nullptr) {
+      return startCommand(*command, args, result);
+    }
+#if USE_COMMAND_STATS
+    // the command might register new commands, so we keep the id
+    int stats_id = statsId(command);
+    CountingPrint out(result);
+    unsigned long start = micros();
+    bool ok = executeCommand(*command, args, out);
+    statsOf(stats_id)->add(micros() - start, out.count(), ok);
     return ok;
+#else
+    return executeCommand(*command, args, result);
+#endif
   }
 
-  /// Parses the command and parameters: syntax: cmd(param1,param2,...) or cmd
-  /// par1 par2 ...
-  bool parseCommand(const char* input, telnet::Str& cmd,
-                    telnet::Vector<telnet::Str>& parameters) {
-    // filter out invalid commands
-    if (!isValidFirstChar(input[0])) {
-      TELNET_LOGE("Command ignored: %s", input);
-      return false;
+  /// Calls the (non resumable) command
+  bool executeCommand(const Command& command, const Arguments& args,
+                      Print& result) {
+    if (command.handler != nullptr) {
+      return command.handler(args, result, this);
     }
-    TELNET_LOGE("Command: %s", input);
-
-    cmd = input;
-    char delimiter;
-    int offset;
-    int end;
-    // check if function or list syntax
-    int pos = cmd.indexOf('(');
-    if (pos != -1) {
-      delimiter = ',';
-      offset = 1;
-      end = cmd.indexOf(')');
-      if (end == -1) {
-        return false;
-      }
-    } else {
-      pos = cmd.indexOf(' ');
-      delimiter = ' ';
-      offset = 0;
-      end = cmd.length();
-    }
-    // if there are no parameters, we use the whole command
-    if (pos == -1) pos = cmd.length();
-
-    // determine cmd
-    cmd.substr(input, 0, pos);
-    telnet::Str tail = "";
-    assert(tail.isEmpty());
-    // determine parameters
-    if (pos > 0) tail.substr(input, pos + offset, end);
-    telnet::Str par = "";
-    TELNET_LOGI("cmd: '%s'", cmd.c_str());
-
-    while (!tail.isEmpty()) {
-      split(tail, par, tail, delimiter);
-      TELNET_LOGI("- par: '%s'", par.c_str());
-      parameters.push_back(par);
+    if (command.context_handler != nullptr) {
+      return command.context_handler(args, result, command.context);
     }
-    return true;
+    if (command.typed != nullptr) {
+      return processTypedCommand(command, args, result);
+    }
+    // the legacy callbacks get a copy
+    return callCallback(command.callback, args, result);
   }
 
-  // / Splits the string into head and tail at the first comma
-  void split(telnet::Str& str, telnet::Str& head, telnet::Str& tail,
-             char sep = ',') {
-    // Use single quotes for aruments with spaces
-    str.trim();
-    int start_pos = 0;
-    int end_pos = -1;
-    if (str.startsWith("'")) {
-      end_pos = str.indexOf("'", 1);
-      start_pos = 1;  // Skip the first quote
-    } else if (str.startsWith("\"")) {
-      // Use of quotes for aruments with spaces
-      end_pos = str.indexOf("\"", 1);
-      start_pos = 1;  // Skip the first quote
-    } else {
-      end_pos = str.indexOf(sep);
+  /// Converts the arguments with the schema and calls the typed command
+  bool processTypedCommand(const Command& command, const Arguments& args,
+                           Print& out) {
+    const ArgSchema& schema = *command.schema;
+    // the values are kept on the stack
+    ArgSchema::Aligned values[schema.values_size / sizeof(ArgSchema::Aligned) +
+                              1];
+    if (!schema.parse(args, values, out)) {
+      out.print("Usage: ");
+      out.print(command.cmd);
+      out.print(" ");
+      out.println(command.parameter_help);
+      return false;
     }
+    return schema.invoker(command.typed, values, out, command.context);
+  }
 
-    if (end_pos == -1) {
-      head = str;
-      tail = "";
-    } else {
-      head.substr(str, start_pos, end_pos);
-      tail.substr(str, end_pos + start_pos, str.length());
-      tail.trim();
+  /// Starts a resumable command: if there is no state to keep it, it is
+  /// executed to the end
+  bool startCommand(const Command& command, const Arguments& args,
+                    Print& out) {
+    CommandState local_state;
+    CommandState& state =
+        p_command_state != nullptr ? *p_command_state : local_state;
+    state.end();
+    // the state outlives the input line, so we need to copy the parameters
+    state.cmd = args.cmd();
+    copyParameters(args, state.parameters);
+    state.callback = command.step;
+    state.context = command.context;
+#if USE_COMMAND_STATS
+    state.stats_id = statsId(&command);
+#endif
+    bool result = runCommand(state, out);
+    if (p_command_state == nullptr) {
+      while (result && state.isActive()) result = runCommand(state, out);
     }
-    TELNET_LOGI("head: '%s' - len: %d", head.c_str(), head.length());
-    TELNET_LOGI("tail: '%s' - len: %d", tail.c_str(), tail.length());
+    return result;
   }
 
-  bool isValidFirstChar(char c) {
-    if (c == '\375') return true;
-    if (isAlpha(c)) return true;
-    return false;
+  /// Executes the command which has been determined by lookupCommand() to
+  /// the end w/o using the command state and the statistics of the server:
+  /// so it can be called by a worker thread. Resumable commands are not
+  /// paused, so the output must block when it is full.
+  bool runToEnd(const Command* command, const Arguments& args, Print& out) {
+    if (command == nullptr) return processCommandUndefined(args, out);
+    if (command->step == nullptr) return executeCommand(*command, args, out);
+    CommandState state;
+    state.cmd = args.cmd();
+    copyParameters(args, state.parameters);
+    state.callback = command->step;
+    state.context = command->context;
+    StepResult rc = StepResult::Continue;
+    while (rc == StepResult::Continue) {
+      rc = state.callback(state, out, this);
+      state.step++;
+    }
+    state.end();
+    return rc != StepResult::Error;
   }
 
-  /// process the command
-  bool processCommand(telnet::Str& cmd, telnet::Vector<telnet::Str> parameters,
-                      Print& result) {
-    for (auto& command : commands) {
-      if (cmd.equalsIgnoreCase(command.cmd)) {
-        TELNET_LOGI("Command: '%s'", cmd.c_str());
-        for (auto& parameter : parameters) {
-          TELNET_LOGI("- Parameter: '%s'", parameter.c_str());
-        }
-        return command.callback(cmd, parameters, result, this);
-      }
+  /// Continues a running resumable command and reports errors
+  void resumeCommand(CommandState& state, Print& out) {
+    if (runCommand(state, out)) return;
+    if (error_handler != nullptr) {
+      Arguments args;
+      args.setCommand(state.cmd.c_str());
+      for (auto& parameter : state.parameters) args.add(parameter.c_str());
+      error_handler(args, out, this);
+    }
+    if (error_callback != nullptr) {
+      error_callback(state.cmd, state.parameters, out, this);
     }
-    return processCommandUndefined(cmd, parameters, result);
   }
 
-  /// Handle undefined commands
+  /// Executes the steps of a resumable command for max one time slice or
+  /// until the output is blocked: returns false if the command failed
+  bool runCommand(CommandState& state, Print& result) {
+#if USE_COMMAND_STATS
+    CountingPrint out(result);
+    unsigned long start_us = micros();
+#else
+    Print& out = result;
+#endif
+    unsigned long start = millis();
+    StepResult rc = StepResult::Continue;
+    while (rc == StepResult::Continue) {
+      rc = state.callback(state, out, this);
+      state.step++;
+      if (millis() - start >= (unsigned long)step_time_slice) break;
+      if (isOutputBlocked()) break;
+    }
+#if USE_COMMAND_STATS
+    // we record the sum of all time slices when the command has ended
+    state.stats_us += micros() - start_us;
+    state.stats_bytes += out.count();
+    if (rc != StepResult::Continue && state.stats_id >= 0) {
+      statsOf(state.stats_id)
+          ->add(state.stats_us, state.stats_bytes, rc != StepResult::Error);
+    }
+#endif
+    if (rc != StepResult::Continue) state.end();
+    return rc != StepResult::Error;
+  }
+
+  /// Returns true if the output can not take any more data: resumable
+  /// commands are paused
+  virtual bool isOutputBlocked() { return false; }
+
+  /// Handle undefined commands: by default we call the legacy
+  /// processCommandUndefined() with a copy of the arguments, so that existing
+  /// overrides keep working. Override this method to avoid the copy.
+  virtual bool processCommandUndefined(const Arguments& args, Print& result) {
+    return callCallback(undefinedCallback, args, result);
+  }
+
+  /// Handle undefined commands (legacy API)
   virtual bool processCommandUndefined(telnet::Str& cmd,
                                        telnet::Vector<telnet::Str> parameters,
                                        Print& result) {
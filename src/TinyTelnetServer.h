@@ -1,10 +1,38 @@
 #pragma once
 #include "Client.h"
+#include "TelnetProtocol.h"
 #include "TinySerialServer.h"
 #include "TinyTelnetServerConfig.h"
+#include "Utils/BufferedPrint.h"
+#include "Utils/SlotTable.h"
+#include "Utils/TimerWheel.h"
+#include "Utils/TokenBucket.h"
+#include "Utils/WorkerPool.h"
 
 namespace telnet {
 
+/// Called by the TinyTelnetServer at the end of each pass: by default we just
+/// sleep if there was nothing to do. Servers which can wait for network
+/// events provide their own overload (e.g. EpollServer).
+template <class Server>
+inline void waitForClients(Server& server, int timeout_ms) {
+  if (timeout_ms > 0) delay(timeout_ms);
+}
+
+/// Called by the TinyTelnetServer when a client has been assigned to a
+/// session slot (or with -1 when it has been released): servers which report
+/// the ready clients remember the slot
+template <class Server, class Client>
+inline void bindClient(Server& server, Client& client, int slot) {}
+
+/// Calls the callback with the slot of each client which got ready since the
+/// last call: returns false if the server can not report the ready clients,
+/// so that all clients are served in each pass
+template <class Server, class Callback>
+inline bool readyClients(Server& server, Callback callback) {
+  return false;
+}
+
 /**
  * @brief A simple telnet server for Arduino. Call the addCommand method to
  * register your commands.
@@ -14,17 +42,43 @@ namespace telnet {
 template <class Server, class Client>
 class TinyTelnetServer : public TinySerialServer {
  public:
+  /// Statistics of the accepted connections
+  struct AcceptStats {
+    /// number of accepted connections
+    unsigned long accepted = 0;
+    /// number of connections which were rejected because all slots were used
+    unsigned long rejected = 0;
+    /// time in us between the last two checks which accepted a client: this
+    /// is the upper limit of the time the client was waiting to be accepted
+    unsigned long poll_interval_us = 0;
+    /// max value of poll_interval_us
+    unsigned long max_poll_interval_us = 0;
+  };
+
   /// Default Constructor that expects a class Server, class Client as template parameters
   TinyTelnetServer(Server& server) {
     p_server = &server;
+    for (int j = 0; j < sessions.capacity(); j++) {
+      sessions[j].output.setOutput(sessions[j].client);
+    }
+    setCommandRateLimit(RATE_LIMIT_COMMANDS);
+    setByteRateLimit(RATE_LIMIT_BYTES);
     // register help command
     addCommand("help", cmd_help);
     addCommand("bye", cmd_bye, ": (no parameters) - Closes the session");
-    addCommand("\375", cmd_bye);  // Ctrl-Z/Ctrl-C close the session)
   }
+
+  /// Destructor: closes all sessions
+  ~TinyTelnetServer() { end(); }
+
   /// Start the server
   bool begin() override {
     p_server->begin();
+    idle_timers.begin(millis());
+    last_accept_check = micros();
+#if USE_WORKER_THREADS
+    if (worker_count > 0) workers.begin(worker_count);
+#endif
     is_active = true;
     return is_active;
   }
@@ -33,218 +87,766 @@ class TinyTelnetServer : public TinySerialServer {
   /// not available for all server implementations
   void end() override {
     is_active = false;
-    for (auto& client : clients) {
-      client.stop();
+#if USE_WORKER_THREADS
+    // wait for the running commands
+    for (int j = 0; j < sessions.size(); j++) {
+      Session& session = sessions[sessions.usedSlot(j)];
+      if (session.p_job != nullptr) session.p_job->output.close();
     }
-    clients.clear();
+    workers.end();
+#endif
+    for (int j = 0; j < sessions.size(); j++) {
+      Session& session = sessions[sessions.usedSlot(j)];
+#if USE_WORKER_THREADS
+      delete session.p_job;
+      session.p_job = nullptr;
+#endif
+      session.state.end();
+      session.client.stop();
+    }
+    sessions.clear();
+    idle_timers.clear();
+    for (int j = 0; j < pending_count; j++) {
+      sessions[pending_slots[j]].is_pending = false;
+    }
+    pending_count = 0;
     // Commented out because not available for EthernetServer!
     // if (p_server) {
     //   p_server->end();
     // }
   }
 
-  /// proccess the next command: call in loop()
+  /// proccess the next command: call in loop(). All clients which have data
+  /// are served in round robin order, each with a budget of max lines per
+  /// pass. We only sleep if there was nothing to do. Servers which report
+  /// the ready clients (e.g. EpollServer) only serve these clients and the
+  /// clients which have not finished their work yet.
   bool processCommand() override {
     if (!is_active) return false;
-    
-    // reconnect
-    connectClients();
-
-    // process all clients
-    for (Client& client : clients) {
-      if (client.connected()) {
-        // process the new client with standard functionality
-        if (client.available() > 3) {
-          TELNET_LOGI("available: %d bytes", client.available());
-          char input[max_input_buffer_size];
-          int len = readLine(client, input, max_input_buffer_size);
-          // process command codes
-          int start = parseTelnetCommands(input, len, client);
-          TELNET_LOGD("len: %d - start: %d", len, start);
-          // end if all telnet commands are processed
-          if (start == len) return true;
-
-          // process user command
-          return processCommand(input + start, client);
-        } else {
-          // no data available
-          delay(no_connect_delay);
+
+    // collect the clients which got ready since the last pass
+    is_event_driven = readyClients(*p_server, [this](int slot) {
+      if (slot >= 0 && slot < sessions.capacity() && sessions.isUsed(slot)) {
+        markPending(slot);
+      }
+    });
+
+    // reconnect: there might be more clients waiting
+    bool has_work = connectClients();
+
+    // close idle sessions
+    if (idle_timeout > 0) {
+      idle_timers.expire(millis(), [this](int slot) { processIdle(slot); });
+    }
+
+    bool result = false;
+    bool has_closed = false;
+    char line[max_input_buffer_size];
+    if (is_event_driven) {
+      // the sessions which need more work stay in the list for the next pass
+      int n = pending_count;
+      pending_count = 0;
+      for (int j = 0; j < n; j++) {
+        int slot = pending_slots[j];
+        Session& session = sessions[slot];
+        session.is_pending = false;
+        if (!sessions.isUsed(slot)) continue;
+        if (processSession(slot, line, result, has_closed)) has_work = true;
+        if (needsService(session)) markPending(slot);
+      }
+    } else {
+      int n = sessions.size();
+      if (next_client >= n) next_client = 0;
+      for (int j = 0; j < n; j++) {
+        int idx = (next_client + j) % n;
+        if (processSession(sessions.usedSlot(idx), line, result, has_closed)) {
+          has_work = true;
+          // the next pass starts after the last served client
+          last_served = idx;
         }
       }
+      if (n > 0) next_client = (last_served + 1) % n;
     }
-    return false;
+    // a released slot can be used by a waiting client
+    if (has_closed && releaseSessions() > 0) has_work = true;
+
+    // no data available for any client: wait
+    waitForClients(*p_server, has_work ? 0 : waitTime());
+    return result;
   }
 
   /// provide number of clients
-  int count() { return clients.size(); }
+  int count() { return sessions.size(); }
 
   /// provide number of active clients
-  int countActive() {
-    int count = 0;
-    for (auto& client : clients) {
-      if (client.connected()) {
-        count++;
+  int countActive() { return sessions.size(); }
+
+  /// Closes sessions w/o any input for the indicated time in ms (0 = never).
+  /// If a warning time is defined, the client is informed this time before
+  /// the session is closed.
+  void setIdleTimeout(unsigned long timeout_ms, unsigned long warning_ms = 0) {
+    idle_timeout = timeout_ms;
+    idle_warning = warning_ms < timeout_ms ? warning_ms : 0;
+    for (int j = 0; j < sessions.size(); j++) {
+      int slot = sessions.usedSlot(j);
+      if (idle_timeout > 0) {
+        scheduleIdle(slot);
+      } else {
+        idle_timers.cancel(slot);
       }
     }
-    return count;
+  }
+
+  /// Provides the statistics of the accepted connections
+  AcceptStats& acceptStats() { return accept_stats; }
+
+  /// Defines the max number of clients (max is MAX_CLIENTS): additional
+  /// connections are rejected
+  void setMaxClients(int count) { sessions.setMaxSize(count); }
+
+  /// Defines the max time in ms we wait when there is nothing to do: default
+  /// is NO_CONNECT_DELAY_MS. Event driven servers (e.g. EpollServer) only use
+  /// it while a session has unfinished work (e.g. unsent output).
+  void setNoConnectDelay(int ms) { no_connect_delay = ms; }
+
+  /// Limits the number of commands per second of each session (0 =
+  /// unlimited): a command consumes the weight of the command (see
+  /// setCommandWeight()). When the limit is reached, the next commands of
+  /// the session are deferred. Burst is the max number of commands which
+  /// can be executed at once (default = per second).
+  void setCommandRateLimit(unsigned long per_second,
+                           unsigned long burst = 0) {
+    for (int j = 0; j < sessions.capacity(); j++) {
+      sessions[j].command_limit.setRate(per_second, burst);
+    }
+  }
+
+  /// Limits the number of output bytes per second of each session (0 =
+  /// unlimited): when the limit is reached, resumable commands are paused
+  /// and the next commands of the session are deferred.
+  void setByteRateLimit(unsigned long per_second, unsigned long burst = 0) {
+    for (int j = 0; j < sessions.capacity(); j++) {
+      sessions[j].byte_limit.setRate(per_second, burst);
+    }
+  }
+
+  /// Requests the character mode from new clients: the server echos the
+  /// input and completes the commands (and with a completer also the
+  /// parameters) with TAB. Default is USE_CHARACTER_MODE
+  void setCharacterMode(bool active) { is_character_mode = active; }
+
+#if USE_WORKER_THREADS
+  /// Defines the number of worker threads which execute the commands: 0
+  /// executes the commands in processCommand(). Call before begin(). Only
+  /// the commands which have been marked as thread safe are executed in
+  /// parallel: the others are serialized with a mutex.
+  void setWorkerCount(int count) { worker_count = count; }
+#endif
+
+  /// Defines the size of the output buffer per client: default is
+  /// OUTPUT_BUFFER_SIZE; 0 disables the buffering
+  void setOutputBufferSize(int size) {
+    output_buffer_size = size;
+    for (int j = 0; j < sessions.capacity(); j++) {
+      sessions[j].output.resize(size);
+    }
+  }
+
+  /// Defines the max number of output bytes per client which are queued if
+  /// the client is not ready: default is OUTPUT_QUEUE_SIZE; 0 disables the
+  /// queue. We never block on a full queue: resumable commands are paused,
+  /// but the output of other commands which does not fit is dropped, so the
+  /// queue should be able to hold their biggest response.
+  void setOutputQueueSize(int size) {
+    output_queue_size = size;
+    for (int j = 0; j < sessions.capacity(); j++) {
+      sessions[j].output.setQueueSize(size);
+    }
   }
 
   /// close callback: you can register it with addCommand under different names
-  static bool cmd_bye(telnet::Str& cmd,
-                        telnet::Vector<telnet::Str> parameters, Print& out,
-                        TinySerialServer* self) {
-    Client& client = (Client&)out;
-    client.println("Bye");
-    client.stop();
+  static bool cmd_bye(const Arguments& args, Print& out,
+                      TinySerialServer* self) {
+    TinyTelnetServer* server = (TinyTelnetServer*)self;
+    out.println("Bye");
+    out.flush();
+#if USE_WORKER_THREADS
+    // we are running in a worker: the session is closed by the owner
+    Job* job = static_cast<Job*>(WorkerPool::currentJob());
+    if (job != nullptr) {
+      job->is_close_requested = true;
+      return true;
+    }
+#endif
+    if (server->p_session != nullptr) server->p_session->client.stop();
     return true;
   }
 
  protected:
+#if USE_WORKER_THREADS
+  struct Job;
+#endif
+
+  /// Connection specific data
+  struct Session {
+    Client client;
+    /// incomplete input lines are kept here until they are complete
+    RingBuffer input;
+    /// telnet protocol state
+    TelnetProtocol telnet;
+    /// small writes are collected and sent together
+    BufferedPrint output;
+    /// state of the running resumable command
+    CommandState state;
+    /// the client has disconnected: the slot can be released
+    bool is_closed = false;
+    /// time in ms of the last input
+    unsigned long last_activity = 0;
+    /// the idle warning has been sent
+    bool is_idle_warned = false;
+    /// limit of the commands per second
+    TokenBucket command_limit;
+    /// limit of the output bytes per second
+    TokenBucket byte_limit;
+    /// output bytes which have been consumed from the byte_limit
+    unsigned long charged_bytes = 0;
+#if USE_WORKER_THREADS
+    /// command which is executed by a worker
+    Job* p_job = nullptr;
+#endif
+    /// the session is served in the next pass (event driven servers)
+    bool is_pending = false;
+  };
+
+#if USE_WORKER_THREADS
+  /// Command which is executed by a worker thread: the command is looked up
+  /// by the owner of the session, so the worker does not need to access any
+  /// state of the server
+  struct Job : public WorkerPool::Job {
+    TinyTelnetServer* p_server = nullptr;
+    /// session which gets the output: only used by the owner
+    Session* p_session = nullptr;
+    Str line;
+    /// copy of the command: nullptr for undefined commands
+    Command command;
+    const Command* p_command = nullptr;
+    bool is_thread_safe = false;
+    /// output which is passed on to the session
+    WorkerOutput output;
+    bool is_submitted = false;
+    /// set by the worker to close the session
+    bool is_close_requested = false;
+    bool result = false;
+#if USE_COMMAND_STATS
+    /// statistics which are merged by the owner when the job is done
+    int stats_id = -1;
+    uint32_t stats_us = 0;
+    uint32_t stats_bytes = 0;
+#endif
+    void run() override {
+      if (is_thread_safe) {
+        execute();
+        return;
+      }
+      // all other commands are executed one after the other
+      LockGuard guard(p_server->command_mutex);
+      execute();
+    }
+
+    void execute() {
+      char tmp[line.length() + 1];
+      strcpy(tmp, line.c_str());
+      Arguments args;
+      if (!args.parse(tmp)) return;
+#if USE_COMMAND_STATS
+      CountingPrint out(output);
+      unsigned long start = micros();
+      result = p_server->runToEnd(p_command, args, out);
+      stats_us = micros() - start;
+      stats_bytes = out.count();
+#else
+      result = p_server->runToEnd(p_command, args, output);
+#endif
+      if (!result) p_server->reportError(args, output);
+    }
+  };
+  WorkerPool workers;
+  Mutex command_mutex;
+  int worker_count = WORKER_THREADS;
+#endif
+
   Server* p_server = nullptr;
-  telnet::Vector<Client> clients;
+  SlotTable<Session, MAX_CLIENTS> sessions;
+  TimerWheel<MAX_CLIENTS> idle_timers;
+  unsigned long idle_timeout = IDLE_TIMEOUT_MS;
+  unsigned long idle_warning = 0;
+  AcceptStats accept_stats;
+  unsigned long last_accept_check = 0;
+  Session* p_session = nullptr;
   int no_connect_delay = NO_CONNECT_DELAY_MS;
+  bool is_character_mode = USE_CHARACTER_MODE;
+  int output_buffer_size = OUTPUT_BUFFER_SIZE;
+  int output_queue_size = OUTPUT_QUEUE_SIZE;
   int port = 23;
-  const char SE = 240;
-  const char SB = 250;
-  const char IAC = 255;
-  const char DO = 253;
-  const char DONT = 254;
-  const char WILL = 251;
-  const char WONT = 252;
-  const char SUPPRESS_GA = 3;
-  const char STATUS = 5;
-  const char LINEMODE = 34;
   int active_clients = 0;
+  int next_client = 0;
+  int last_served = -1;
+  /// the server reports the ready clients: we only serve the pending
+  /// sessions
+  bool is_event_driven = false;
+  int pending_slots[MAX_CLIENTS];
+  int pending_count = 0;
 
-  bool processCommand(const char* input, Client& result) {
-    return TinySerialServer::processCommand(input, (Print&)result);
+  /// Serves a single session: returns true if there was anything to do
+  bool processSession(int slot, char* line, bool& result, bool& has_closed) {
+    Session& session = sessions[slot];
+    if (!session.client.connected()) {
+      // the slot is released at the end of the pass
+      session.is_closed = true;
+      has_closed = true;
+      return false;
+    }
+    // send the pending output: as long as the client did not consume it,
+    // the session is suspended and we do not process any new commands
+    int bytes = session.output.drain();
+    // a client which consumes the output is not idle
+    if (bytes > 0) session.last_activity = millis();
+    bytes += readInput(session);
+    if (session.telnet.isInterrupted()) {
+      // Ctrl-C/Ctrl-Z close the session
+      session.state.end();
+      session.client.println("Bye");
+      session.client.stop();
+      return true;
+    }
+    // continue the running command for one time slice
+    if (session.state.isActive() && session.output.queued() == 0 &&
+        !isThrottled(session)) {
+      resumeCommand(session);
+      bytes++;
+    }
+#if USE_WORKER_THREADS
+    // pass on the output of the command which is executed by a worker
+    if (session.p_job != nullptr) bytes += processJob(session, result);
+#endif
+    // process all complete lines: the responses are sent together
+    int lines = 0;
+    while (lines < max_lines_per_pass && isReady(session)) {
+      int len = readLine(session.input, line, max_input_buffer_size);
+      if (len < 0) {
+        // we might have stopped reading because the buffer was full
+        if (readInput(session) == 0) break;
+        len = readLine(session.input, line, max_input_buffer_size);
+        if (len < 0) break;
+      }
+      lines++;
+      session.command_limit.consume(commandWeight(line), millis());
+#if USE_WORKER_THREADS
+      if (workers.isActive()) {
+        submitJob(session, line);
+        continue;
+      }
+#endif
+      if (processCommand(line, session)) result = true;
+    }
+    session.output.flush();
+    return lines > 0 || bytes > 0;
   }
 
-  /// Acccepts new clients
-  void connectClients() {
-    auto tmp = p_server->accept();
-    if (tmp.connected()) {
-      tmp.setTimeout(CLIENT_TIMEOUT_MS);
-      addClient(tmp);
-      TELNET_LOGI("%s", "New client connected");
+  /// Returns true if the session must be served again w/o waiting for an
+  /// event of the client: e.g. because there are unprocessed lines or
+  /// output which has not been sent yet
+  bool needsService(Session& session) {
+    if (!session.client.connected()) return true;
+    if (session.state.isActive() || session.output.queued() > 0 ||
+        session.output.available() > 0) {
+      return true;
     }
+#if USE_WORKER_THREADS
+    if (session.p_job != nullptr) return true;
+#endif
+    // complete lines which have not been processed or data which did not
+    // fit into the input buffer
+    return session.input.indexOf('\n') >= 0 || session.client.available() > 0;
+  }
 
-    // log change of active clients
-    if (active_clients != countActive()) {
-      active_clients = countActive();
-      TELNET_LOGI("active clients: %d", active_clients);
+  /// Adds the session to the sessions which are served in the next pass
+  void markPending(int slot) {
+    Session& session = sessions[slot];
+    if (!is_event_driven || session.is_pending) return;
+    session.is_pending = true;
+    pending_slots[pending_count++] = slot;
+  }
+
+  /// Max time in ms we wait for clients when there is nothing to do: event
+  /// driven servers wait until the next idle timer expires (-1 = forever)
+  int waitTime() {
+    if (!is_event_driven || pending_count > 0) return no_connect_delay;
+    long result = idle_timeout > 0 ? idle_timers.nextExpiry(millis()) : -1;
+    if (result < 0) return -1;
+    // the wheel only advances with the next tick
+    return result > 0 ? result : 1;
+  }
+
+  /// Moves the available bytes into the input buffer: telnet commands are
+  /// removed and answered
+  int readInput(Session& session) {
+    RingBuffer& buffer = session.input;
+    if (buffer.size() != max_input_buffer_size) {
+      buffer.resize(max_input_buffer_size);
+    }
+    int result = 0;
+    uint8_t tmp[64];
+    int len;
+    while ((len = readAvailable(session.client, tmp, sizeof(tmp),
+                                buffer.availableForWrite())) > 0) {
+      result += len;
+      session.last_activity = millis();
+      session.is_idle_warned = false;
+      len = session.telnet.filter(tmp, len, session.output);
+      if (session.telnet.isCharacterMode()) {
+        editInput(session, tmp, len);
+      } else {
+        buffer.write(tmp, len);
+      }
     }
+    return result;
   }
 
-  /// Adds a new client to the list of clients
-  void addClient(Client& client) {
-    for (auto& c : clients) {
-      if (!c.connected()) {
-        c = client;
-        return;
+  /// Line editing in character mode: we echo the input and support backspace
+  /// and the completion with TAB
+  void editInput(Session& session, const uint8_t* data, int len) {
+    RingBuffer& buffer = session.input;
+    Print& out = session.output;
+    for (int j = 0; j < len; j++) {
+      uint8_t value = data[j];
+      switch (value) {
+        case '\t':
+          completeInput(session);
+          break;
+        case '\b':
+        case 127:
+          if (editLength(buffer) > 0) {
+            buffer.removeLast();
+            out.print("\b \b");
+          }
+          break;
+        case '\n':
+          if (buffer.write(value)) out.print("\r\n");
+          break;
+        case '\r':
+          buffer.write(value);
+          break;
+        default:
+          // ignore the other control characters
+          if (value >= ' ' && buffer.write(value)) out.write(value);
+          break;
       }
     }
-    clients.push_back(client);
-  }
-
-  /// Parse and process the telnet commands
-  int parseTelnetCommands(char* cmds, int len, Print& client) {
-    TELNET_LOGD("parseTelnetCommands: %d", len);
-    int start = 0;
-    char cmd[80];
-    while (cmds[start] == IAC) {
-      int len = 3;
-      if (cmds[start + 1] == SB) {
-        // subnegotiation
-        TELNET_LOGD("---> subnegotiation %d", start + 1);
-        int end = start + 2;
-        while (cmds[end] != SE && end < len) {
-          end++;
-        }
-        assert(cmds[end] == SE);
-        len = end - start;
+  }
+
+  /// Number of characters of the incomplete line
+  int editLength(RingBuffer& buffer) {
+    return buffer.available() - (buffer.lastIndexOf('\n') + 1);
+  }
+
+  /// Completes the incomplete line: if there are multiple candidates w/o a
+  /// common prefix, we list them
+  void completeInput(Session& session) {
+    RingBuffer& buffer = session.input;
+    Print& out = session.output;
+    int start = buffer.available() - editLength(buffer);
+    int len = buffer.available() - start;
+    char line[len + 1];
+    for (int j = 0; j < len; j++) line[j] = buffer.peek(start + j);
+    line[len] = 0;
+
+    char result[max_input_buffer_size];
+    int count = complete(line, result, sizeof(result));
+    if (count == 0) {
+      out.write('\a');
+      return;
+    }
+    int result_len = strlen(result);
+    // a unique command or file is followed by a space
+    if (count == 1 && result[result_len - 1] != '/' &&
+        result_len < (int)sizeof(result) - 1) {
+      result[result_len++] = ' ';
+      result[result_len] = 0;
+    }
+    if (result_len > len) {
+      for (int j = len; j < result_len; j++) {
+        if (buffer.write(result[j])) out.write(result[j]);
       }
-      strncpy(cmd, cmds + start, len);
-      processTelnetCommand(cmd, len, client);
-      start += len;
-    }
-
-    return start;
-  }
-
-  // Telnet options:
-  // 0	BINARY	Binary transmission
-  // 1	ECHO	Remote echo
-  // 3	SUPPRESS-GA	Suppress "Go Ahead"
-  // 24	TERMINAL-TYPE	Terminal type (e.g., xterm)
-  // 31	NAWS	Negotiate About Window Size
-  // 32	TERMINAL-SPEED	Terminal speed info
-  // 33	REMOTE-FLOW-CONTROL	Flow control settings
-  // 34	LINEMODE	Line-oriented mode
-  // 36	ENVIRONMENT	Send environment variables
-
-  /// Converts the telnet command to a string
-  const char* controlStr(int cmd) {
-    if (cmd == 253) return "DO";
-    if (cmd == 254) return "DONT";
-    if (cmd == 251) return "WILL";
-    if (cmd == 252) return "WONT";
-    if (cmd == 250) return "SB";  // Start subnegotiation
-
-    static char str[30];
-    snprintf(str, sizeof(str), "Unknown (%d)", cmd);
-    return str;
-  }
-
-  /// Process telnet protocol command
-  void processTelnetCommand(char* cmd, int len, Print& client) {
-    assert(cmd[0] == IAC);
-    TELNET_LOGD("telnet cmd:%s %d (len=%d)", controlStr(cmd[1]), cmd[2], len);
-    // confirm all do request
-    if (cmd[1] == DO) {
-      // DO -> WILL or WONT
-      cmd[1] = WILL;
-      if (cmd[2] == STATUS) {
-        // suppress go ahead
-        cmd[1] = WONT;
+    } else if (count > 1) {
+      // list the candidates and repeat the input
+      out.print("\r\n");
+      complete(line, result, sizeof(result), &out);
+      out.print("\r\n");
+      out.print(line);
+    }
+  }
+
+  /// Processes the command: the output is sent with the output of the other
+  /// commands of the same batch
+  bool processCommand(char* line, Session& session) {
+    p_session = &session;
+    p_command_state = &session.state;
+    bool result = TinySerialServer::processCommand(line, session.output);
+    p_command_state = nullptr;
+    p_session = nullptr;
+    return result;
+  }
+
+  /// Continues the running resumable command of the session
+  void resumeCommand(Session& session) {
+    p_session = &session;
+    TinySerialServer::resumeCommand(session.state, session.output);
+    session.output.flush();
+    p_session = nullptr;
+  }
+
+  /// We pause resumable commands when the client does not consume the output
+  /// or when the session has used up its output rate
+  bool isOutputBlocked() override {
+    if (p_session == nullptr) return false;
+    return p_session->output.queued() > 0 || isThrottled(*p_session);
+  }
+
+#if USE_WORKER_THREADS
+  /// The arena is not thread safe: the commands which are executed by a
+  /// worker use the heap
+  ArenaAllocator* commandArena() override {
+    if (WorkerPool::currentJob() != nullptr) return nullptr;
+    return TinySerialServer::commandArena();
+  }
+#endif
+
+  /// Returns true if the session can process the next line
+  bool isReady(Session& session) {
+#if USE_WORKER_THREADS
+    if (session.p_job != nullptr) return false;
+#endif
+    return session.output.queued() == 0 && !session.state.isActive() &&
+           !isThrottled(session);
+  }
+
+  /// Returns true if the session has used up its command or output rate: we
+  /// defer the processing until the tokens have been refilled
+  bool isThrottled(Session& session) {
+    unsigned long now = millis();
+    if (session.byte_limit.isLimited()) {
+      unsigned long written = session.output.written();
+      session.byte_limit.consume(written - session.charged_bytes, now);
+      session.charged_bytes = written;
+    }
+    return !session.command_limit.isAvailable(now) ||
+           !session.byte_limit.isAvailable(now);
+  }
+
+#if USE_WORKER_THREADS
+  /// Passes the line to a worker: we process the next line of the session
+  /// only when the command has ended to keep the order
+  void submitJob(Session& session, const char* line) {
+    Job* job = new Job();
+    job->p_server = this;
+    job->p_session = &session;
+    job->line = line;
+    // the worker must not search the commands: the index might be rebuilt
+    const Command* command = findLineCommand(line);
+    if (command != nullptr) {
+      job->command = *command;
+      job->p_command = &job->command;
+      job->is_thread_safe = command->is_thread_safe;
+#if USE_COMMAND_STATS
+      job->stats_id = statsId(command);
+#endif
+    }
+    session.p_job = job;
+    job->is_submitted = workers.submit(job);
+  }
+
+  /// Passes the output of the worker to the client and releases the job when
+  /// the command has ended: returns the number of processed bytes
+  int processJob(Session& session, bool& result) {
+    Job* job = session.p_job;
+    // the queue was full: try again
+    if (!job->is_submitted) job->is_submitted = workers.submit(job);
+    int bytes = 0;
+    uint8_t tmp[128];
+    int len;
+    while (session.output.queued() == 0 &&
+           (len = job->output.peekBytes(tmp, sizeof(tmp))) > 0) {
+      // we keep what the session output can not take
+      int written = session.output.write(tmp, len);
+      job->output.consume(written);
+      bytes += written;
+      if (written < len) break;
+    }
+    session.output.flush();
+    if (job->is_done && job->output.available() == 0) {
+      if (job->result) result = true;
+#if USE_COMMAND_STATS
+      if (job->p_command != nullptr) {
+        statsOf(job->stats_id)
+            ->add(job->stats_us, job->stats_bytes, job->result);
       }
-      client.write(cmd, len);
-      TELNET_LOGD("-> reply:%s %d", controlStr(cmd[1]), cmd[2]);
-    } else if (cmd[1] == WILL) {
-      // WILL -> DO or DONT
-      cmd[1] = DONT;
-      if (cmd[2] == SUPPRESS_GA || cmd[2] == LINEMODE) {
-        // accept line mode negotiation
-        cmd[1] = DO;
+#endif
+      if (job->is_close_requested) job->p_session->client.stop();
+      delete job;
+      session.p_job = nullptr;
+      bytes++;
+    }
+    return bytes;
+  }
+
+  /// The client is gone: the output of the worker is discarded
+  void releaseJob(Session& session) {
+    Job* job = session.p_job;
+    job->output.close();
+    if (!job->is_submitted || job->is_done) {
+      delete job;
+      session.p_job = nullptr;
+    }
+  }
+#endif
+
+  /// Acccepts all pending clients: the number of accepted clients in one
+  /// pass is limited by the max number of clients. Returns true if a client
+  /// was waiting, so that we check again w/o delay.
+  bool connectClients() {
+    unsigned long now = micros();
+    bool result = false;
+    for (int j = 0; j < sessions.maxSize(); j++) {
+      auto tmp = p_server->accept();
+      if (!tmp.connected()) break;
+      // a pending client has been waiting max since the last check
+      accept_stats.poll_interval_us = now - last_accept_check;
+      if (accept_stats.poll_interval_us > accept_stats.max_poll_interval_us) {
+        accept_stats.max_poll_interval_us = accept_stats.poll_interval_us;
       }
-      client.write(cmd, len);
-      TELNET_LOGD("-> reply:%s %d", controlStr(cmd[1]), cmd[2]);
-    } else if (cmd[1] == SB && cmd[2] == LINEMODE) {
-      // Acknowledges only MODE_EDIT accepted
-      char tmp[7] = {IAC, SB, 34, 1, 01, IAC, SE};
-      TELNET_LOGD("-> reply %d (len=%d)", tmp[2], sizeof(tmp));
-      client.write(tmp, sizeof(tmp));
-      client.println("> Welcome to TinyTelnetServer");
-    }
-  }
-
-  /// Handle undefined commands
-  virtual bool processCommandUndefined(telnet::Str& cmd,
-                                       telnet::Vector<telnet::Str> parameters,
-                                       Print& result) {
-    if (cmd.c_str() != nullptr && isalpha(cmd.c_str()[0])) {
-      char str[160];
-      snprintf(str, sizeof(str), "Invalid command: '%s'", cmd.c_str());
-      result.print(str);
-      result.println("- type 'help' for a list of commands");
-      result.println();
-      TELNET_LOGE("%s", str);
-    } else {
-      int start = parseTelnetCommands((char*)cmd.c_str(), cmd.length(), result);
-      TELNET_LOGE("Not Processed: %s", cmd.c_str() + start);
+      tmp.setTimeout(CLIENT_TIMEOUT_MS);
+      result = true;
+      if (addClient(tmp)) {
+        accept_stats.accepted++;
+        TELNET_LOGI("%s", "New client connected");
+      } else {
+        accept_stats.rejected++;
+        TELNET_LOGW("max clients reached: %d", sessions.maxSize());
+        tmp.println("Too many connections");
+        tmp.stop();
+      }
+    }
+    last_accept_check = now;
+
+    // log change of active clients
+    if (active_clients != countActive()) {
+      active_clients = countActive();
+      TELNET_LOGI("active clients: %d", active_clients);
+    }
+    return result;
+  }
+
+  /// Assigns the client to a free slot: returns false if all slots are used
+  bool addClient(Client& client) {
+    int slot = sessions.acquire();
+    if (slot < 0) return false;
+    Session& session = sessions[slot];
+    session.client = client;
+    session.is_closed = false;
+    session.input.clear();
+    session.telnet.reset();
+    session.output.clear();
+    session.output.setOutput(session.client);
+    if (is_character_mode) session.telnet.requestCharacterMode(session.output);
+    session.last_activity = millis();
+    session.is_idle_warned = false;
+    session.command_limit.reset(session.last_activity);
+    session.byte_limit.reset(session.last_activity);
+    session.charged_bytes = session.output.written();
+    if (idle_timeout > 0) scheduleIdle(slot);
+    bindClient(*p_server, session.client, slot);
+    // there might be data already
+    markPending(slot);
+    return true;
+  }
+
+  /// Releases the slots of the disconnected clients: returns the number of
+  /// released slots
+  int releaseSessions() {
+    int result = 0;
+    // release from the end, so that we do not miss any moved entry
+    for (int j = sessions.size() - 1; j >= 0; j--) {
+      int slot = sessions.usedSlot(j);
+      Session& session = sessions[slot];
+      if (!session.is_closed) continue;
+#if USE_WORKER_THREADS
+      // the session is still in use by a worker
+      if (session.p_job != nullptr) releaseJob(session);
+      if (session.p_job != nullptr) continue;
+#endif
+      session.state.end();
+      bindClient(*p_server, session.client, -1);
+      session.client = Client();
+      idle_timers.cancel(slot);
+      sessions.release(slot);
+      result++;
     }
+    return result;
+  }
 
-    return false;
+  /// Schedules the idle timer of the session: the activity is only recorded
+  /// in the session and checked when the timer expires
+  void scheduleIdle(int slot) {
+    Session& session = sessions[slot];
+    unsigned long time = session.last_activity + idle_timeout;
+    if (idle_warning > 0 && !session.is_idle_warned) time -= idle_warning;
+    idle_timers.schedule(slot, time);
+  }
+
+  /// Returns true if the session is executing a command which is not waiting
+  /// for the client: pending input and output which is not consumed are
+  /// subject to the idle timeout
+  bool isBusy(Session& session) {
+    if (session.output.queued() > 0) return false;
+#if USE_WORKER_THREADS
+    if (session.p_job != nullptr) return true;
+#endif
+    return session.state.isActive();
+  }
+
+  /// The idle timer of the session has expired: we check if there was any
+  /// activity in the meantime
+  void processIdle(int slot) {
+    Session& session = sessions[slot];
+    if (session.is_closed) return;
+    unsigned long now = millis();
+    unsigned long idle = now - session.last_activity;
+    // running commands are not considered to be idle
+    if (isBusy(session)) {
+      session.last_activity = now;
+      idle = 0;
+    }
+    if (idle >= idle_timeout) {
+      TELNET_LOGI("closing idle session: %d", slot);
+      session.state.end();
+      session.output.println("Session closed due to inactivity");
+      session.output.flush();
+      session.client.stop();
+      // the slot is released in the next pass
+      markPending(slot);
+      return;
+    }
+    if (idle_warning > 0 && !session.is_idle_warned &&
+        idle >= idle_timeout - idle_warning) {
+      session.is_idle_warned = true;
+      session.output.print("Session will be closed in ");
+      session.output.print((idle_timeout - idle + 999) / 1000);
+      session.output.println(" seconds due to inactivity");
+      session.output.flush();
+      markPending(slot);
+    }
+    scheduleIdle(slot);
   }
 };
 
@@ -5,11 +5,102 @@
 #  define MAX_INPUT_BUFFER_SIZE 256
 #endif
 
+/// The max time in ms that a resumable command runs in one loop
+#ifndef STEP_TIME_SLICE_MS
+#  define STEP_TIME_SLICE_MS 5
+#endif
+
+/// The output is sent in chunks of this size (should match the TCP MSS)
+#ifndef OUTPUT_BUFFER_SIZE
+#  define OUTPUT_BUFFER_SIZE 1436
+#endif
+
+/// Max number of output bytes per client which are queued when the client is
+/// not ready to receive them
+#ifndef OUTPUT_QUEUE_SIZE
+#  define OUTPUT_QUEUE_SIZE 4096
+#endif
+
+/// Check availableForWrite() of the client to avoid blocking writes
+#ifndef USE_AVAILABLE_FOR_WRITE
+#  define USE_AVAILABLE_FOR_WRITE true
+#endif
+
 /// The delay in ms between two connection attempts
 #ifndef NO_CONNECT_DELAY_MS
 #  define NO_CONNECT_DELAY_MS 10
 #endif
 
+/// The max number of telnet clients which are served in parallel: the
+/// EpollServer uses 1024 if its header is included first
+#ifndef MAX_CLIENTS
+#  define MAX_CLIENTS 8
+#endif
+
+/// Idle sessions are closed after this time in ms: 0 = never
+#ifndef IDLE_TIMEOUT_MS
+#  define IDLE_TIMEOUT_MS 0
+#endif
+
+/// Resolution of the idle timer in ms
+#ifndef IDLE_TIMER_TICK_MS
+#  define IDLE_TIMER_TICK_MS 1000
+#endif
+
+/// Number of buckets of the idle timer wheel
+#ifndef IDLE_TIMER_SLOTS
+#  define IDLE_TIMER_SLOTS 64
+#endif
+
+/// The max number of lines which are processed per client in one loop: the
+/// responses of these commands are sent together
+#ifndef MAX_LINES_PER_PASS
+#  define MAX_LINES_PER_PASS 32
+#endif
+
+/// Defines the max number of parameters of a command
+#ifndef MAX_ARGUMENTS
+#  define MAX_ARGUMENTS 16
+#endif
+
+/// Commands can be called by an unambiguous abbreviation: off by default
+/// because a new command can make an abbreviation ambiguous
+#ifndef USE_ABBREVIATIONS
+#  define USE_ABBREVIATIONS false
+#endif
+
+/// The telnet server requests the character mode, so that it can complete
+/// the input with TAB
+#ifndef USE_CHARACTER_MODE
+#  define USE_CHARACTER_MODE false
+#endif
+
+/// Defines the max number of static command tables (see addCommands())
+#ifndef MAX_COMMAND_TABLES
+#  define MAX_COMMAND_TABLES 4
+#endif
+
+/// Collects the number of calls, errors, written bytes and a latency
+/// histogram for each command (see the stats command)
+#ifndef USE_COMMAND_STATS
+#  define USE_COMMAND_STATS false
+#endif
+
+/// Number of log2 buckets of the command latency histogram
+#ifndef COMMAND_STATS_BUCKETS
+#  define COMMAND_STATS_BUCKETS 16
+#endif
+
+/// Max number of commands per second and session (0 = unlimited)
+#ifndef RATE_LIMIT_COMMANDS
+#  define RATE_LIMIT_COMMANDS 0
+#endif
+
+/// Max number of output bytes per second and session (0 = unlimited)
+#ifndef RATE_LIMIT_BYTES
+#  define RATE_LIMIT_BYTES 0
+#endif
+
 /// Defines the client timeout in ms
 #ifndef CLIENT_TIMEOUT_MS
 #  define CLIENT_TIMEOUT_MS 50
@@ -30,8 +121,81 @@
 #  define MAX_LOG_MSG_SIZE 160
 #endif
 
+/// Execute the telnet commands in a pool of worker threads
+#ifndef USE_WORKER_THREADS
+#  define USE_WORKER_THREADS false
+#endif
+
+/// Default number of worker threads
+#ifndef WORKER_THREADS
+#  define WORKER_THREADS 2
+#endif
+
+/// Max number of commands which are waiting for a worker
+#ifndef WORKER_QUEUE_SIZE
+#  define WORKER_QUEUE_SIZE 16
+#endif
+
+/// Size of the buffer which passes the output of a worker to the session
+#ifndef WORKER_OUTPUT_SIZE
+#  define WORKER_OUTPUT_SIZE 512
+#endif
+
+/// For ESP32 only: stack size of the worker tasks
+#ifndef WORKER_STACK_SIZE
+#  define WORKER_STACK_SIZE 8192
+#endif
+
+/// For ESP32 only: priority of the worker tasks
+#ifndef WORKER_PRIORITY
+#  define WORKER_PRIORITY 1
+#endif
+
+/// For ESP32 only: core of the worker tasks (the loop() runs on core 1)
+#ifndef WORKER_CORE
+#  define WORKER_CORE 0
+#endif
+
+/// Max number of epoll events which are processed in one call
+#ifndef EPOLL_MAX_EVENTS
+#  define EPOLL_MAX_EVENTS 64
+#endif
+
+/// Receive buffer size of the EpollClient
+#ifndef EPOLL_RX_BUFFER_SIZE
+#  define EPOLL_RX_BUFFER_SIZE 256
+#endif
+
+/// Size of the buffer of telnet::Str which is used w/o heap: longer strings
+/// are allocated on the heap
+#ifndef STR_INLINE_SIZE
+#  define STR_INLINE_SIZE 16
+#endif
+
+/// Size of the ArenaAllocator which is used for the parameters of the
+/// legacy callbacks
+#ifndef ARENA_SIZE
+#  define ARENA_SIZE 2048
+#endif
+
+/// Max number of size classes of the PoolAllocator
+#ifndef POOL_MAX_SIZE_CLASSES
+#  define POOL_MAX_SIZE_CLASSES 8
+#endif
+
+/// Collects the live and peak bytes, the number of allocations and a size
+/// histogram for each Allocator (see the mem command)
+#ifndef USE_ALLOCATOR_STATS
+#  define USE_ALLOCATOR_STATS false
+#endif
+
+/// Number of log2 buckets of the allocation size histogram
+#ifndef ALLOCATOR_STATS_BUCKETS
+#  define ALLOCATOR_STATS_BUCKETS 16
+#endif
+
 /// Automatically include the telnet namespace
 #if defined(ARDUINO) || defined(USE_TELNET_NS)
 namespace telnet {}
 using namespace telnet;
-#endif
\ No newline at end of file
+#endif
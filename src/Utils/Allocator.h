@@ -11,6 +11,51 @@ namespace telnet {
  * @brief Allocators and Memory Manager
  */
 
+/**
+ * @brief Statistics of an allocator: the currently allocated (live) bytes,
+ * the max value of it, the number of allocations and a histogram of the
+ * requested sizes with log2 buckets: bucket n counts the requests with
+ * 2^(n-1) < size <= 2^n bytes. The last bucket takes all bigger requests.
+ * @ingroup memorymgmt
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct AllocatorStats {
+  size_t live_bytes = 0;
+  size_t peak_bytes = 0;
+  uint32_t allocations = 0;
+  uint32_t releases = 0;
+  uint32_t failures = 0;
+  uint32_t histogram[ALLOCATOR_STATS_BUCKETS] = {0};
+
+  /// Records an allocation of the requested size which uses the indicated
+  /// number of bytes
+  void allocated(size_t size, size_t bytes) {
+    allocations++;
+    histogram[bucket(size)]++;
+    live_bytes += bytes;
+    if (live_bytes > peak_bytes) peak_bytes = live_bytes;
+  }
+
+  /// Records the release of the indicated number of bytes
+  void released(size_t bytes) {
+    releases++;
+    live_bytes -= bytes;
+  }
+
+  /// Upper limit in bytes of the indicated bucket
+  static size_t bucketEnd(int bucket) { return (size_t)1 << bucket; }
+
+  /// Provides the histogram bucket for the indicated size
+  static int bucket(size_t size) {
+    int result = 0;
+    while (result < ALLOCATOR_STATS_BUCKETS - 1 && bucketEnd(result) < size) {
+      result++;
+    }
+    return result;
+  }
+};
+
 /**
  * @brief Memory allocateator which uses malloc.
  * @ingroup memorymgmt
@@ -20,10 +65,16 @@ namespace telnet {
 
 class Allocator {
  public:
+  /// Called when an allocation has failed: return true to try again (e.g.
+  /// after releasing some memory) or false to return nullptr. W/o callback
+  /// we stop like before.
+  using OutOfMemoryCallback = bool (*)(size_t size, Allocator& allocator);
+
   // creates an object
   template <class T>
   T* create() {
     void* addr = allocate(sizeof(T));
+    if (addr == nullptr) return nullptr;
     // call constructor
     T* ref = new (addr) T();
     return ref;
@@ -41,6 +92,7 @@ class Allocator {
   template <class T>
   T* createArray(int len) {
     void* addr = allocate(sizeof(T) * len);
+    if (addr == nullptr) return nullptr;
     T* addrT = (T*)addr;
     // call constructor
 #ifndef NO_INPLACE_INIT_SUPPORT
@@ -64,26 +116,82 @@ class Allocator {
     free((void*)obj);
   }
 
-  /// Allocates memory
+  /// Allocates memory: returns nullptr if the memory is not available and
+  /// the out of memory callback gives up
   virtual void* allocate(size_t size) {
-    void* result = do_allocate(size);
-    if (result == nullptr) {
-      while (true);
-    } else {
-    }
-    return result;
+#if USE_ALLOCATOR_STATS
+    // we keep the size in front of the memory
+    uint8_t* result = (uint8_t*)allocateOrReport(size, STATS_HEADER_SIZE);
+    if (result == nullptr) return nullptr;
+    *(size_t*)result = size;
+    stats.allocated(size, size);
+    return result + STATS_HEADER_SIZE;
+#else
+    return allocateOrReport(size);
+#endif
   }
 
   /// frees memory
   virtual void free(void* memory) {
-    if (memory != nullptr) ::free(memory);
+    if (memory == nullptr) return;
+#if USE_ALLOCATOR_STATS
+    uint8_t* block = (uint8_t*)memory - STATS_HEADER_SIZE;
+    stats.released(*(size_t*)block);
+    memory = block;
+#endif
+    ::free(memory);
+  }
+
+  /// Returns true if the memory is released all at once at the end of a
+  /// scope (e.g. ArenaAllocator::reset()): Vectors which are copied or moved
+  /// from such an allocator use the DefaultAllocator instead
+  virtual bool isScoped() { return false; }
+
+  /// Defines the callback which is called by all allocators when the memory
+  /// is not available
+  static void setOutOfMemoryCallback(OutOfMemoryCallback callback) {
+    outOfMemoryCallback() = callback;
   }
 
+#if USE_ALLOCATOR_STATS
+  /// Provides the statistics: the values are not synchronized between
+  /// threads
+  AllocatorStats& getStats() { return stats; }
+
+ protected:
+  static constexpr size_t STATS_HEADER_SIZE = 8;
+  AllocatorStats stats;
+#endif
+
  protected:
   virtual void* do_allocate(size_t size) {
     return calloc(1, size == 0 ? 1 : size);
   }
+
+  /// Allocates the memory (with the additional header bytes) and reports a
+  /// failure to the out of memory callback
+  void* allocateOrReport(size_t size, size_t header = 0) {
+    void* result = do_allocate(size + header);
+    while (result == nullptr) {
+#if USE_ALLOCATOR_STATS
+      stats.failures++;
+#endif
+      TELNET_LOGE("allocation failed for %u bytes", (unsigned)size);
+      OutOfMemoryCallback callback = outOfMemoryCallback();
+      // the callers rely on the memory if nobody handles the failure
+      if (callback == nullptr) stop();
+      if (!callback(size, *this)) break;
+      result = do_allocate(size + header);
+    }
+    return result;
+  }
+
   virtual void stop() { while (true); }
+
+  static OutOfMemoryCallback& outOfMemoryCallback() {
+    static OutOfMemoryCallback callback = nullptr;
+    return callback;
+  }
 };
 
 /**
@@ -101,12 +209,8 @@ class AllocatorExt : public Allocator {
     result = ps_malloc(size);
 #endif
     if (result == nullptr) result = malloc(size);
-    if (result == nullptr) {
-      Serial.println("allocateation failed");
-      stop();
-    }
     // initialize object
-    memset(result, 0, size);
+    if (result != nullptr) memset(result, 0, size);
     return result;
   }
 };
@@ -129,10 +233,6 @@ class AllocatorESP32 : public Allocator {
     void* result = nullptr;
     if (size == 0) size = 1;
     result = heap_caps_calloc(1, size, caps);
-    if (result == nullptr) {
-      TELNET_LOGE("alloc failed for %zu bytes", size);
-      stop();
-    }
     return result;
   }
 
@@ -157,10 +257,6 @@ class AllocatorPSRAM : public Allocator {
     if (size == 0) size = 1;
     void* result = nullptr;
     result = ps_calloc(1, size);
-    if (result == nullptr) {
-      TELNET_LOGE("allocateation failed for %zu bytes", size);
-      stop();
-    }
     return result;
   }
 };
@@ -0,0 +1,123 @@
+#pragma once
+#include "../TinyTelnetServerConfig.h"
+#include "Allocator.h"
+
+namespace telnet {
+
+/**
+ * @brief Allocator for short lived objects: the memory is taken from a
+ * preallocated region by just moving a pointer and is only given back all at
+ * once with reset(). If the region is full, the fallback allocator is used.
+ * Only the last allocated block is given back immediately when it is
+ * released: all other blocks stay in use until reset(). Vectors which are
+ * copied or moved out of the arena use the DefaultAllocator, so that they
+ * outlive the reset. The region is allocated from the fallback allocator on
+ * the first use unless a buffer has been provided.
+ * The allocator is not thread safe.
+ * @ingroup memorymgmt
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class ArenaAllocator : public Allocator {
+ public:
+  /// Arena with a region of the indicated size
+  ArenaAllocator(size_t size = ARENA_SIZE,
+                 Allocator& fallback = DefaultAllocator) {
+    region_size = size;
+    p_fallback = &fallback;
+  }
+
+  /// Arena which uses the provided buffer
+  ArenaAllocator(uint8_t* buffer, size_t size,
+                 Allocator& fallback = DefaultAllocator) {
+    p_region = buffer;
+    region_size = size;
+    p_fallback = &fallback;
+  }
+
+  ~ArenaAllocator() {
+    if (is_region_owned) p_fallback->free(p_region);
+  }
+
+  /// Allocates the memory from the region: if it is full we use the fallback
+  void* allocate(size_t size) override {
+    size_t aligned = (size + 7) & ~(size_t)7;
+    if (aligned == 0) aligned = 8;
+    if (p_region == nullptr && region_size > 0) {
+      p_region = (uint8_t*)p_fallback->allocate(region_size);
+      is_region_owned = true;
+    }
+    if (p_region != nullptr && pos + aligned <= region_size) {
+      p_last = p_region + pos;
+      pos += aligned;
+      memset(p_last, 0, size);
+#if USE_ALLOCATOR_STATS
+      stats.allocated(size, aligned);
+#endif
+      return p_last;
+    }
+    fallback_count++;
+    return p_fallback->allocate(size);
+  }
+
+  /// The memory is released by reset(): it must not be kept
+  bool isScoped() override { return true; }
+
+  /// Memory from the region is only released by reset(), except for the
+  /// last allocated block
+  void free(void* memory) override {
+    if (memory == nullptr) return;
+    if (!isInRegion(memory)) {
+      p_fallback->free(memory);
+      return;
+    }
+    if (memory == p_last) {
+      size_t last_pos = p_last - p_region;
+#if USE_ALLOCATOR_STATS
+      stats.released(pos - last_pos);
+#endif
+      pos = last_pos;
+      p_last = nullptr;
+    }
+  }
+
+  /// Provides the current position which can be used to reset the arena
+  /// to this point
+  size_t mark() { return pos; }
+
+  /// Releases all memory which has been allocated after the mark in O(1):
+  /// the related objects must not be used any more
+  void reset(size_t mark = 0) {
+    if (mark < pos) pos = mark;
+    p_last = nullptr;
+#if USE_ALLOCATOR_STATS
+    stats.live_bytes = pos;
+#endif
+  }
+
+  /// Number of used bytes in the region
+  size_t used() { return pos; }
+
+  /// Size of the region
+  size_t size() { return region_size; }
+
+  /// Number of allocations which did not fit into the region
+  size_t fallbackCount() { return fallback_count; }
+
+ protected:
+  Allocator* p_fallback = nullptr;
+  uint8_t* p_region = nullptr;
+  uint8_t* p_last = nullptr;
+  size_t region_size = 0;
+  size_t pos = 0;
+  size_t fallback_count = 0;
+  bool is_region_owned = false;
+
+  bool isInRegion(void* memory) {
+    uint8_t* ptr = (uint8_t*)memory;
+    return p_region != nullptr && ptr >= p_region &&
+           ptr < p_region + region_size;
+  }
+};
+
+}  // namespace telnet
@@ -0,0 +1,263 @@
+#pragma once
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "../TinyTelnetServerConfig.h"
+#include "Arduino.h"
+#include "Arguments.h"
+
+namespace telnet {
+
+/// Type of a command argument
+enum class ArgType : uint8_t { Int, Flag, Enum, String };
+
+/**
+ * @brief Definition of a single command argument: the converted value is
+ * stored at the offset of the field in the typed argument struct. Arguments
+ * with a name starting with - are options (e.g. -n 10 or -r) which can be
+ * anywhere, all others are positional in the order of the definition.
+ * Int and Enum fields are int, Flag fields are bool and String fields are
+ * const char* which point into the input line.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct ArgSpec {
+  const char* name;
+  ArgType type;
+  /// offset of the field in the argument struct: use offsetof()
+  uint16_t offset;
+  bool is_required;
+  /// valid range of Int arguments
+  long min;
+  long max;
+  /// default value for Int and Enum arguments
+  long default_value;
+  /// choices of Enum arguments separated by | or the default of Strings
+  const char* text;
+
+  /// Integer argument which must be in the range min..max
+  static constexpr ArgSpec intArg(const char* name, uint16_t offset, long min,
+                                  long max, long default_value = 0,
+                                  bool is_required = false) {
+    return ArgSpec{name,      ArgType::Int, offset,        is_required,
+                   min,       max,          default_value, nullptr};
+  }
+
+  /// Option w/o value (e.g. -r) which sets the bool field to true
+  static constexpr ArgSpec flagArg(const char* name, uint16_t offset) {
+    return ArgSpec{name, ArgType::Flag, offset, false, 0, 1, 0, nullptr};
+  }
+
+  /// One of the choices separated by | (e.g. "on|off"): the field gets the
+  /// index of the choice
+  static constexpr ArgSpec enumArg(const char* name, uint16_t offset,
+                                   const char* choices,
+                                   long default_value = 0,
+                                   bool is_required = false) {
+    return ArgSpec{name, ArgType::Enum, offset,        is_required,
+                   0,    0,             default_value, choices};
+  }
+
+  /// String argument: the field points into the input line
+  static constexpr ArgSpec stringArg(const char* name, uint16_t offset,
+                                     const char* default_value = nullptr,
+                                     bool is_required = false) {
+    return ArgSpec{name, ArgType::String, offset,  is_required,
+                   0,    0,               0,       default_value};
+  }
+
+  /// Returns true if the argument is an option (name starts with -)
+  bool isOption() const { return name[0] == '-'; }
+};
+
+/**
+ * @brief Argument schema of a command: the arguments are validated and
+ * converted in one pass into the typed argument struct before the command
+ * is called, so invalid input is rejected before the command runs. A schema
+ * supports max 32 arguments. Define it with create():
+ *
+ * struct HeadArgs { int lines; const char* file; };
+ * static const ArgSpec head_args[] = {
+ *     ArgSpec::intArg("-n", offsetof(HeadArgs, lines), 1, 1000, 10),
+ *     ArgSpec::stringArg("FILE", offsetof(HeadArgs, file), nullptr, true)};
+ * static const ArgSchema head_schema = ArgSchema::create<HeadArgs>(head_args);
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct ArgSchema {
+  /// generic function pointer of the typed command
+  using Function = bool (*)(const void* values, Print& out, void* context);
+  /// calls the typed command with the converted values
+  using Invoker = bool (*)(Function function, const void* values, Print& out,
+                           void* context);
+  /// unit which is used to allocate correctly aligned values
+  union Aligned {
+    long long ll;
+    double d;
+    void* p;
+  };
+
+  const ArgSpec* specs;
+  int size;
+  /// size of the typed argument struct
+  int values_size;
+  Invoker invoker;
+
+  /// Defines the schema for the indicated argument struct
+  template <class T, int N>
+  static constexpr ArgSchema create(const ArgSpec (&specs)[N]) {
+    return ArgSchema{specs, N, sizeof(T), invoke<T>};
+  }
+
+  /// Calls the typed command
+  template <class T>
+  static bool invoke(Function function, const void* values, Print& out,
+                     void* context) {
+    auto typed = reinterpret_cast<bool (*)(const T&, Print&, void*)>(function);
+    return typed(*static_cast<const T*>(values), out, context);
+  }
+
+  /// Validates and converts the arguments into the values: the error is
+  /// reported to out
+  bool parse(const Arguments& args, void* values, Print& out) const {
+    uint8_t* data = (uint8_t*)values;
+    memset(data, 0, values_size);
+    uint32_t is_set = 0;
+    for (int j = 0; j < size; j++) setDefault(specs[j], data);
+
+    int positional = 0;
+    for (int j = 0; j < args.size(); j++) {
+      const char* arg = args.c_str(j);
+      int idx = findOption(arg);
+      if (idx >= 0 && specs[idx].type == ArgType::Flag) {
+        *(bool*)(data + specs[idx].offset) = true;
+        is_set |= 1ul << idx;
+        continue;
+      }
+      if (idx >= 0) {
+        // option with value
+        if (++j >= args.size()) return error(out, specs[idx], "missing value");
+      } else {
+        idx = nextPositional(positional);
+        if (idx < 0) return error(out, arg, "unexpected argument");
+        positional = idx + 1;
+      }
+      if (!setValue(specs[idx], args.c_str(j), data, out)) return false;
+      is_set |= 1ul << idx;
+    }
+
+    for (int j = 0; j < size; j++) {
+      if (specs[j].is_required && !(is_set & (1ul << j))) {
+        return error(out, specs[j], "missing");
+      }
+    }
+    return true;
+  }
+
+ protected:
+  void setDefault(const ArgSpec& spec, uint8_t* data) const {
+    switch (spec.type) {
+      case ArgType::Int:
+      case ArgType::Enum:
+        *(int*)(data + spec.offset) = spec.default_value;
+        break;
+      case ArgType::Flag:
+        *(bool*)(data + spec.offset) = false;
+        break;
+      case ArgType::String:
+        *(const char**)(data + spec.offset) = spec.text;
+        break;
+    }
+  }
+
+  bool setValue(const ArgSpec& spec, const char* arg, uint8_t* data,
+                Print& out) const {
+    switch (spec.type) {
+      case ArgType::Int: {
+        char* end = nullptr;
+        long value = strtol(arg, &end, 10);
+        if (end == arg || *end != 0) return error(out, spec, "invalid number");
+        if (value < spec.min || value > spec.max) {
+          out.print("Error: ");
+          out.print(spec.name);
+          out.print(" must be between ");
+          out.print(spec.min);
+          out.print(" and ");
+          out.println(spec.max);
+          return false;
+        }
+        *(int*)(data + spec.offset) = value;
+        return true;
+      }
+      case ArgType::Enum: {
+        int idx = findChoice(spec.text, arg);
+        if (idx < 0) {
+          out.print("Error: ");
+          out.print(spec.name);
+          out.print(" must be one of ");
+          out.println(spec.text);
+          return false;
+        }
+        *(int*)(data + spec.offset) = idx;
+        return true;
+      }
+      case ArgType::String:
+        *(const char**)(data + spec.offset) = arg;
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  /// Provides the index of the option or -1
+  int findOption(const char* arg) const {
+    if (arg[0] != '-') return -1;
+    for (int j = 0; j < size; j++) {
+      if (specs[j].isOption() && strcmp(specs[j].name, arg) == 0) return j;
+    }
+    return -1;
+  }
+
+  /// Provides the index of the next positional argument or -1
+  int nextPositional(int start) const {
+    for (int j = start; j < size; j++) {
+      if (!specs[j].isOption()) return j;
+    }
+    return -1;
+  }
+
+  /// Provides the index of the choice in the | separated list or -1
+  static int findChoice(const char* choices, const char* arg) {
+    int len = strlen(arg);
+    int idx = 0;
+    for (const char* pos = choices; *pos != 0; idx++) {
+      const char* end = strchr(pos, '|');
+      int choice_len = end == nullptr ? strlen(pos) : end - pos;
+      if (choice_len == len && equalsIgnoreCase(pos, arg, len)) return idx;
+      if (end == nullptr) break;
+      pos = end + 1;
+    }
+    return -1;
+  }
+
+  static bool equalsIgnoreCase(const char* s1, const char* s2, int len) {
+    for (int j = 0; j < len; j++) {
+      if (tolower(s1[j]) != tolower(s2[j])) return false;
+    }
+    return true;
+  }
+
+  static bool error(Print& out, const ArgSpec& spec, const char* msg) {
+    return error(out, spec.name, msg);
+  }
+
+  static bool error(Print& out, const char* name, const char* msg) {
+    out.print("Error: ");
+    out.print(name);
+    out.print(": ");
+    out.println(msg);
+    return false;
+  }
+};
+
+}  // namespace telnet
@@ -0,0 +1,137 @@
+#pragma once
+#include "../TinyTelnetServerConfig.h"
+#include "Logger.h"
+#include "StrView.h"
+
+namespace telnet {
+
+/**
+ * @brief Command name and parameters of a command line which has been
+ * tokenized in place: the entries point into the original line buffer, so
+ * parsing does not need any heap. The line must stay valid while the
+ * arguments are used.
+ *
+ * Supported syntax: cmd(par1, par2, ...) or cmd par1 par2 ... Parameters
+ * which contain a delimiter can be quoted with ' or ".
+ * @ingroup string
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class Arguments {
+ public:
+  /// Splits the line into the command and the parameters: the line is
+  /// modified. Returns false if the line is not a valid command.
+  bool parse(char* line) {
+    clear();
+    // filter out invalid commands
+    if (!isValidFirstChar(line[0])) {
+      TELNET_LOGE("Command ignored: %s", line);
+      return false;
+    }
+    TELNET_LOGI("Command: %s", line);
+
+    // determine cmd: it ends with a space or the opening bracket
+    char* pos = line;
+    while (*pos != 0 && *pos != '(' && !isSpace(*pos)) pos++;
+    p_cmd = line;
+    char delimiter = ' ';
+    char* next = skipSpaces(pos);
+    if (*next == '(') {
+      *pos = 0;
+      pos = next;
+      delimiter = ',';
+      *pos++ = 0;
+      // the parameters end with the last closing bracket
+      char* end = strrchr(pos, ')');
+      if (end != nullptr) *end = 0;
+    } else if (*pos != 0) {
+      *pos++ = 0;
+    }
+    TELNET_LOGI("cmd: '%s'", p_cmd);
+
+    // determine parameters
+    while (true) {
+      pos = skipSpaces(pos);
+      if (*pos == 0) break;
+      if (count >= MAX_ARGUMENTS) {
+        TELNET_LOGE("Too many parameters: max %d", MAX_ARGUMENTS);
+        return false;
+      }
+      pos = nextToken(pos, delimiter);
+      TELNET_LOGI("- par: '%s'", items[count - 1]);
+    }
+    return true;
+  }
+
+  /// Provides the command name
+  const char* cmd() const { return p_cmd; }
+
+  /// Number of parameters
+  int size() const { return count; }
+
+  /// Provides the indicated parameter as string view
+  StrView operator[](int idx) const { return StrView(items[idx]); }
+
+  /// Provides the indicated parameter as char*
+  const char* c_str(int idx) const { return items[idx]; }
+
+  /// Defines the command name: the string must stay valid
+  void setCommand(const char* cmd) { p_cmd = cmd != nullptr ? cmd : ""; }
+
+  /// Adds a parameter: the string must stay valid
+  bool add(const char* parameter) {
+    if (count >= MAX_ARGUMENTS) return false;
+    items[count++] = parameter;
+    return true;
+  }
+
+  /// Removes the command and all parameters
+  void clear() {
+    p_cmd = "";
+    count = 0;
+  }
+
+ protected:
+  const char* p_cmd = "";
+  const char* items[MAX_ARGUMENTS];
+  int count = 0;
+
+  /// Adds the token which starts at the indicated position and returns the
+  /// position of the next token
+  char* nextToken(char* pos, char delimiter) {
+    char quote = 0;
+    if (*pos == '\'' || *pos == '"') quote = *pos++;
+    items[count++] = pos;
+    if (quote != 0) {
+      char* end = strchr(pos, quote);
+      if (end == nullptr) return pos + strlen(pos);
+      *end = 0;
+      // ignore everything up to the next delimiter
+      pos = end + 1;
+      while (*pos != 0 && *pos != delimiter) pos++;
+      return *pos == 0 ? pos : pos + 1;
+    }
+    while (*pos != 0 && *pos != delimiter) pos++;
+    char* end = pos;
+    if (*pos != 0) pos++;
+    // remove trailing spaces
+    while (end > items[count - 1] && isSpace(end[-1])) end--;
+    *end = 0;
+    return pos;
+  }
+
+  static char* skipSpaces(char* pos) {
+    while (isSpace(*pos)) pos++;
+    return pos;
+  }
+
+  static bool isSpace(char c) { return c == ' ' || c == '\t'; }
+
+  static bool isValidFirstChar(char c) {
+    if (c == '\375') return true;
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) return true;
+    return false;
+  }
+};
+
+}  // namespace telnet
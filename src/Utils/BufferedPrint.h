@@ -0,0 +1,172 @@
+#pragma once
+#include "../TinyTelnetServerConfig.h"
+#include "Arduino.h"
+#include "Logger.h"
+#include "RingBuffer.h"
+#include "Vector.h"
+
+namespace telnet {
+
+/**
+ * @brief Print which collects the output in a buffer and forwards it in
+ * chunks of the buffer size to the final output: this way many small print()
+ * calls end up in only a few network packets. The data is sent when the buffer
+ * is full or when flush() is called.
+ *
+ * If the final output can not take the data w/o blocking (as reported by
+ * availableForWrite()), the data is kept in a bounded queue which is sent
+ * with drain(). We never block: if the queue is full, write() only takes what
+ * fits and returns the number of accepted bytes, so the caller can try again
+ * later.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class BufferedPrint : public Print {
+ public:
+  /// Default constructor: call setOutput() to define the final output
+  BufferedPrint() = default;
+
+  /// Constructor which defines the final output and the buffer size
+  BufferedPrint(Print& out, int size = OUTPUT_BUFFER_SIZE) {
+    setOutput(out);
+    resize(size);
+  }
+
+  /// Defines the final output
+  void setOutput(Print& out) {
+    p_out = &out;
+    is_available_for_write_supported = false;
+  }
+
+  /// Defines the buffer size: 0 disables the buffering. The buffer is
+  /// allocated on first use.
+  void resize(int size) {
+    flush();
+    buffer_size = size;
+    buffer.resize(0);
+  }
+
+  /// Defines the max number of bytes which are queued when the final output
+  /// is not ready: 0 disables the queue
+  void setQueueSize(int size) { queue_size = size; }
+
+  /// Activates/deactivates the check of availableForWrite() of the final
+  /// output
+  void setCheckAvailableForWrite(bool active) {
+    is_check_available_for_write = active;
+  }
+
+  using Print::write;
+
+  size_t write(uint8_t value) override { return write(&value, 1); }
+
+  size_t write(const uint8_t* data, size_t len) override {
+    if (p_out == nullptr) return 0;
+    size_t result = 0;
+    if (buffer_size <= 0) {
+      result = sendOrQueue(data, len);
+    } else {
+      if (buffer.size() != buffer_size) buffer.resize(buffer_size);
+      // the buffer stays full if the queue can not take the data
+      while (result < len && pos < buffer_size) {
+        int n = len - result;
+        if (n > buffer_size - pos) n = buffer_size - pos;
+        memcpy(buffer.data() + pos, data + result, n);
+        pos += n;
+        result += n;
+        if (pos == buffer_size) flush();
+      }
+    }
+    if (result < len) {
+      TELNET_LOGW("output full: %d bytes not accepted", (int)(len - result));
+    }
+    total += result;
+    return result;
+  }
+
+  int availableForWrite() override { return buffer_size - pos; }
+
+  /// Sends the buffered data to the final output: what can not be sent
+  /// immediately is queued and what does not fit into the queue stays in the
+  /// buffer
+  void flush() override {
+    if (pos == 0) return;
+    int n = sendOrQueue(buffer.data(), pos);
+    if (n < pos) memmove(buffer.data(), buffer.data() + n, pos - n);
+    pos -= n;
+  }
+
+  /// Sends as much of the queued data as possible w/o blocking: returns the
+  /// number of sent bytes
+  int drain() {
+    int result = 0;
+    uint8_t tmp[128];
+    while (!queue.isEmpty()) {
+      int len = queue.peekBytes(tmp, sizeof(tmp));
+      int sent = send(tmp, len);
+      queue.consume(sent);
+      result += sent;
+      if (sent < len) break;
+    }
+    return result;
+  }
+
+  /// Removes the buffered and queued data w/o sending it
+  void clear() {
+    pos = 0;
+    queue.clear();
+  }
+
+  /// Number of bytes which are waiting in the buffer to be sent
+  int available() { return pos; }
+
+  /// Number of bytes which are waiting in the queue because the final output
+  /// was not ready
+  int queued() { return queue.available(); }
+
+  /// Total number of bytes which have been written
+  unsigned long written() { return total; }
+
+ protected:
+  Print* p_out = nullptr;
+  Vector<uint8_t> buffer;
+  RingBuffer queue;
+  int buffer_size = OUTPUT_BUFFER_SIZE;
+  int queue_size = OUTPUT_QUEUE_SIZE;
+  int pos = 0;
+  unsigned long total = 0;
+  bool is_check_available_for_write = USE_AVAILABLE_FOR_WRITE;
+  bool is_available_for_write_supported = false;
+
+  /// Sends the data keeping the order with the already queued data: returns
+  /// the number of sent or queued bytes, which is less then len if the queue
+  /// is full
+  int sendOrQueue(const uint8_t* data, int len) {
+    if (p_out == nullptr) return 0;
+    drain();
+    int sent = queue.isEmpty() ? send(data, len) : 0;
+    if (sent == len) return len;
+    if (queue.isEmpty() && queue.size() != queue_size) queue.resize(queue_size);
+    return sent + queue.write(data + sent, len - sent);
+  }
+
+  /// Writes as much as the final output can take w/o blocking. Outputs which
+  /// have never reported any availableForWrite() are considered not to
+  /// support it.
+  int send(const uint8_t* data, int len) {
+    if (is_check_available_for_write) {
+      int available = p_out->availableForWrite();
+      if (available > 0) is_available_for_write_supported = true;
+      if (is_available_for_write_supported && len > available) {
+        len = available;
+      }
+    }
+    // we do not call p_out->flush() because on some clients this is
+    // discarding the received data
+    if (len <= 0) return 0;
+    int result = p_out->write(data, len);
+    return result < 0 ? 0 : result;
+  }
+};
+
+}  // namespace telnet
@@ -0,0 +1,91 @@
+#pragma once
+#include "../TinyTelnetServerConfig.h"
+#include "Arduino.h"
+
+namespace telnet {
+
+/**
+ * @brief Statistics of a single command: number of calls and errors, the
+ * written bytes and a histogram of the execution time with log2 buckets:
+ * bucket 0 counts calls below 1us and bucket n the calls with
+ * 2^(n-1) <= us < 2^n. The last bucket takes all longer calls.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct CommandStats {
+  uint32_t count = 0;
+  uint32_t errors = 0;
+  uint32_t bytes = 0;
+  uint32_t max_us = 0;
+  uint64_t total_us = 0;
+  uint32_t histogram[COMMAND_STATS_BUCKETS] = {0};
+
+  /// Records a single call
+  void add(uint32_t us, uint32_t written, bool ok) {
+    count++;
+    if (!ok) errors++;
+    bytes += written;
+    total_us += us;
+    if (us > max_us) max_us = us;
+    histogram[bucket(us)]++;
+  }
+
+  /// Average execution time in us
+  uint32_t averageUs() const { return count == 0 ? 0 : total_us / count; }
+
+  /// Lower limit in us of the indicated bucket
+  static uint32_t bucketStartUs(int bucket) {
+    return bucket == 0 ? 0 : 1ul << (bucket - 1);
+  }
+
+  /// Provides the histogram bucket for the indicated time
+  static int bucket(uint32_t us) {
+    // count the significant bits: int can have only 16 bits (e.g. AVR)
+    int result = 0;
+    while (us != 0 && result < COMMAND_STATS_BUCKETS - 1) {
+      us >>= 1;
+      result++;
+    }
+    return result;
+  }
+
+  /// Resets all values
+  void clear() { *this = CommandStats(); }
+};
+
+/**
+ * @brief Print which counts the bytes which are written to the final output
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class CountingPrint : public Print {
+ public:
+  CountingPrint(Print& out) : out(out) {}
+
+  using Print::write;
+
+  size_t write(uint8_t value) override {
+    size_t result = out.write(value);
+    written += result;
+    return result;
+  }
+
+  size_t write(const uint8_t* data, size_t len) override {
+    size_t result = out.write(data, len);
+    written += result;
+    return result;
+  }
+
+  int availableForWrite() override { return out.availableForWrite(); }
+
+  void flush() override { out.flush(); }
+
+  /// Number of written bytes
+  uint32_t count() { return written; }
+
+ protected:
+  Print& out;
+  uint32_t written = 0;
+};
+
+}  // namespace telnet
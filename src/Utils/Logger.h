@@ -2,6 +2,9 @@
 #include "../TinyTelnetServerConfig.h"
 #include "Arduino.h"
 #include <stdarg.h>
+#if USE_WORKER_THREADS
+#include <mutex>
+#endif
 
 /// Log levels for the TelnetServer
 enum class TinyTelnetLogLevel { Debug, Info, Warning, Error };
@@ -38,6 +41,10 @@ class Logger {
   /// print log message
   void log(TinyTelnetLogLevel level, const char* ctx, const char* fmt, ...) {
     if (level < logLevel) return;
+#if USE_WORKER_THREADS
+    // the workers are logging concurrently
+    std::lock_guard<std::mutex> guard(mutex);
+#endif
     p_print->print(logLevelStr[(int)level]);
     p_print->print(" [");
     p_print->print(ctx);
@@ -57,6 +64,9 @@ class Logger {
   TinyTelnetLogLevel logLevel = TinyTelnetLogLevel::Warning;
   Print* p_print = &Serial;
   const char* logLevelStr[4] = {"DEBUG", "INFO", "WARN", "ERROR"};
+#if USE_WORKER_THREADS
+  std::mutex mutex;
+#endif
 };
 
 }  // namespace telnet
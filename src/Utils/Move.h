@@ -0,0 +1,66 @@
+#pragma once
+#ifndef __AVR__
+#include <type_traits>
+#include <utility>
+#endif
+
+namespace telnet {
+
+/**
+ * @brief move, forward and enable_if w/o depending on the STL which is not
+ * available for AVR: on all other platforms we just use the std versions.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+namespace stl {
+
+#ifdef __AVR__
+template <class T>
+struct remove_reference {
+  typedef T type;
+};
+template <class T>
+struct remove_reference<T&> {
+  typedef T type;
+};
+template <class T>
+struct remove_reference<T&&> {
+  typedef T type;
+};
+
+template <bool B, class T = void>
+struct enable_if {};
+template <class T>
+struct enable_if<true, T> {
+  typedef T type;
+};
+
+template <class T>
+constexpr typename remove_reference<T>::type&& move(T&& value) {
+  return static_cast<typename remove_reference<T>::type&&>(value);
+}
+
+template <class T>
+constexpr T&& forward(typename remove_reference<T>::type& value) {
+  return static_cast<T&&>(value);
+}
+
+template <class T>
+constexpr T&& forward(typename remove_reference<T>::type&& value) {
+  return static_cast<T&&>(value);
+}
+
+/// the compiler builtin which is also used by the STL
+template <class T>
+struct is_trivially_copyable {
+  static constexpr bool value = __is_trivially_copyable(T);
+};
+#else
+using std::enable_if;
+using std::forward;
+using std::is_trivially_copyable;
+using std::move;
+#endif
+
+}  // namespace stl
+}  // namespace telnet
@@ -0,0 +1,246 @@
+#pragma once
+#include "../TinyTelnetServerConfig.h"
+#include "Allocator.h"
+
+#if defined(ESP32) && defined(ARDUINO)
+#include "freertos/FreeRTOS.h"
+#elif USE_WORKER_THREADS
+#include <atomic>
+#endif
+
+namespace telnet {
+
+/**
+ * @brief Spinlock for very short critical sections: on the ESP32 we use a
+ * critical section, so that a task can not be preempted while it holds the
+ * lock. On other platforms w/o worker threads (e.g. AVR) the lock does
+ * nothing.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SpinLock {
+ public:
+#if defined(ESP32) && defined(ARDUINO)
+  void lock() { portENTER_CRITICAL(&mux); }
+  void unlock() { portEXIT_CRITICAL(&mux); }
+
+ protected:
+  portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+#elif USE_WORKER_THREADS
+  void lock() {
+    while (flag.test_and_set(std::memory_order_acquire));
+  }
+  void unlock() { flag.clear(std::memory_order_release); }
+
+ protected:
+  std::atomic_flag flag = ATOMIC_FLAG_INIT;
+#else
+  void lock() {}
+  void unlock() {}
+#endif
+};
+
+/**
+ * @brief Allocator with fixed size blocks: the blocks of each size class are
+ * carved from a single region which is allocated by begin() and the free
+ * blocks are kept in a list. So allocating and releasing takes constant time
+ * and the heap does not get fragmented. A request is served by the smallest
+ * size class with a free block which is big enough: bigger requests and
+ * requests which can not be served any more are passed on to the fallback
+ * allocator. Pass an AllocatorPSRAM as source to place the region in PSRAM.
+ * If begin() has not been called, it is called with the first allocation.
+ *
+ * PoolAllocator pool;
+ * pool.addSizeClass(32, 64);
+ * pool.addSizeClass(128, 16);
+ * pool.begin();
+ * Vector<Str> list(pool);
+ * @ingroup memorymgmt
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class PoolAllocator : public Allocator {
+ public:
+  /// Defines the allocator for the region and the fallback allocator
+  PoolAllocator(Allocator& source = DefaultAllocator,
+                Allocator& fallback = DefaultAllocator) {
+    p_source = &source;
+    p_fallback = &fallback;
+  }
+
+  ~PoolAllocator() { end(); }
+
+  /// Defines a size class with the indicated number of blocks: call before
+  /// begin()
+  bool addSizeClass(size_t block_size, int count) {
+    if (p_region != nullptr || class_count >= POOL_MAX_SIZE_CLASSES) {
+      return false;
+    }
+    // we need to be able to store the pointer of the free list
+    block_size = (block_size + 7) & ~(size_t)7;
+    if (block_size < sizeof(void*)) block_size = sizeof(void*);
+    // keep the size classes sorted
+    int pos = class_count;
+    while (pos > 0 && size_classes[pos - 1].block_size > block_size) {
+      size_classes[pos] = size_classes[pos - 1];
+      pos--;
+    }
+    size_classes[pos] = SizeClass();
+    size_classes[pos].block_size = block_size;
+    size_classes[pos].count = count;
+    class_count++;
+    return true;
+  }
+
+  /// Allocates the region and builds the free lists: if no size classes
+  /// have been defined we use 16, 32, 64, 128 and 256 bytes
+  bool begin() {
+    lock.lock();
+    if (p_region != nullptr) {
+      lock.unlock();
+      return true;
+    }
+    if (class_count == 0) {
+      addSizeClass(16, 32);
+      addSizeClass(32, 32);
+      addSizeClass(64, 16);
+      addSizeClass(128, 8);
+      addSizeClass(256, 4);
+    }
+    size_t size = 0;
+    for (int j = 0; j < class_count; j++) {
+      size += size_classes[j].block_size * size_classes[j].count;
+    }
+    lock.unlock();
+
+    // we must not allocate in a critical section
+    uint8_t* region = (uint8_t*)p_source->allocate(size);
+    if (region == nullptr) return false;
+
+    lock.lock();
+    // the region is published only after the free lists have been built
+    bool is_used = p_region == nullptr;
+    if (is_used) {
+      uint8_t* start = region;
+      for (int j = 0; j < class_count; j++) {
+        SizeClass& size_class = size_classes[j];
+        size_class.start = start;
+        size_class.free_list = nullptr;
+        size_class.available = size_class.count;
+        // link the blocks in the order of the addresses
+        for (int b = size_class.count - 1; b >= 0; b--) {
+          void** block = (void**)(start + b * size_class.block_size);
+          *block = size_class.free_list;
+          size_class.free_list = block;
+        }
+        start += size_class.block_size * size_class.count;
+      }
+      region_size = size;
+      p_region = region;
+    }
+    lock.unlock();
+    // another thread has been faster
+    if (!is_used) p_source->free(region);
+    return true;
+  }
+
+  /// Releases the region: all blocks must have been released before
+  void end() {
+    lock.lock();
+    uint8_t* region = p_region;
+    p_region = nullptr;
+    lock.unlock();
+    if (region != nullptr) p_source->free(region);
+  }
+
+  /// Provides a block of the smallest size class which fits
+  void* allocate(size_t size) override {
+    lock.lock();
+    if (p_region == nullptr) {
+      lock.unlock();
+      if (!begin()) return p_fallback->allocate(size);
+      lock.lock();
+    }
+    void** block = nullptr;
+    for (int j = 0; j < class_count && block == nullptr; j++) {
+      SizeClass& size_class = size_classes[j];
+      if (size_class.block_size < size) continue;
+      block = (void**)size_class.free_list;
+      if (block != nullptr) {
+        size_class.free_list = *block;
+        size_class.available--;
+#if USE_ALLOCATOR_STATS
+        stats.allocated(size, size_class.block_size);
+#endif
+      }
+    }
+    lock.unlock();
+    if (block == nullptr) return p_fallback->allocate(size);
+    memset(block, 0, size);
+    return block;
+  }
+
+  /// Puts the block back into the free list of its size class
+  void free(void* memory) override {
+    if (memory == nullptr) return;
+    lock.lock();
+    SizeClass* size_class = findSizeClass(memory);
+    if (size_class != nullptr) {
+      *(void**)memory = size_class->free_list;
+      size_class->free_list = memory;
+      size_class->available++;
+#if USE_ALLOCATOR_STATS
+      stats.released(size_class->block_size);
+#endif
+    }
+    lock.unlock();
+    if (size_class == nullptr) p_fallback->free(memory);
+  }
+
+  /// Number of size classes
+  int sizeClassCount() { return class_count; }
+
+  /// Block size of the indicated size class
+  size_t blockSize(int idx) { return size_classes[idx].block_size; }
+
+  /// Number of blocks of the indicated size class
+  int blockCount(int idx) { return size_classes[idx].count; }
+
+  /// Number of free blocks of the indicated size class
+  int available(int idx) { return size_classes[idx].available; }
+
+ protected:
+  struct SizeClass {
+    size_t block_size = 0;
+    int count = 0;
+    int available = 0;
+    uint8_t* start = nullptr;
+    void* free_list = nullptr;
+  };
+  SizeClass size_classes[POOL_MAX_SIZE_CLASSES];
+  int class_count = 0;
+  Allocator* p_source = nullptr;
+  Allocator* p_fallback = nullptr;
+  uint8_t* p_region = nullptr;
+  size_t region_size = 0;
+  SpinLock lock;
+
+  /// Determines the size class from the address of the block: call with
+  /// the lock
+  SizeClass* findSizeClass(void* memory) {
+    uint8_t* ptr = (uint8_t*)memory;
+    if (p_region == nullptr || ptr < p_region ||
+        ptr >= p_region + region_size) {
+      return nullptr;
+    }
+    for (int j = 0; j < class_count; j++) {
+      SizeClass& size_class = size_classes[j];
+      if (ptr < size_class.start + size_class.block_size * size_class.count) {
+        return &size_class;
+      }
+    }
+    return nullptr;
+  }
+};
+
+}  // namespace telnet
@@ -0,0 +1,127 @@
+#pragma once
+#include "../TinyTelnetServerConfig.h"
+#include "Vector.h"
+
+namespace telnet {
+
+/**
+ * @brief Compact prefix tree which maps case insensitive keys to values. The
+ * nodes are kept in a single vector and are linked by their index, so we need
+ * only a few bytes per character and no allocation per node. It is used to
+ * complete commands and to find them by an unambiguous abbreviation.
+ * @ingroup collections
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <class T>
+class PrefixTrie {
+ public:
+  /// Removes all keys
+  void clear() {
+    nodes.clear();
+    values.clear();
+  }
+
+  /// Adds the key: if the key exists already, we keep the first value and
+  /// return false
+  bool add(const char* key, T value) {
+    if (nodes.size() == 0) nodes.push_back(Node());
+    int node = 0;
+    for (const char* pos = key; *pos != 0; pos++) {
+      char c = toLower(*pos);
+      int child = findChild(node, c);
+      if (child < 0) child = addChild(node, c);
+      node = child;
+    }
+    if (nodes[node].value >= 0) return false;
+    values.push_back(value);
+    nodes[node].value = values.size() - 1;
+    return true;
+  }
+
+  /// Provides the value if exactly one key starts with the prefix
+  bool findUnique(const char* prefix, T& value) {
+    int node = find(prefix);
+    if (node < 0) return false;
+    // follow the path as long as there is no branch
+    while (nodes[node].value < 0) {
+      int child = nodes[node].child;
+      if (child < 0 || nodes[child].sibling >= 0) return false;
+      node = child;
+    }
+    // a longer key would make it ambiguous
+    if (nodes[node].child >= 0) return false;
+    value = values[nodes[node].value];
+    return true;
+  }
+
+  /// Calls the callback with the value of each key which starts with the
+  /// prefix
+  template <class Callback>
+  void forEach(const char* prefix, Callback callback) {
+    int node = find(prefix);
+    if (node >= 0) visit(node, callback);
+  }
+
+  /// Number of keys
+  int size() { return values.size(); }
+
+ protected:
+  struct Node {
+    char c = 0;
+    int16_t child = -1;
+    int16_t sibling = -1;
+    int16_t value = -1;
+  };
+  Vector<Node> nodes;
+  Vector<T> values;
+
+  /// Provides the node of the prefix or -1 if no key starts with it
+  int find(const char* prefix) {
+    if (nodes.size() == 0) return -1;
+    int node = 0;
+    for (const char* pos = prefix; *pos != 0 && node >= 0; pos++) {
+      node = findChild(node, toLower(*pos));
+    }
+    return node;
+  }
+
+  /// Adds a new child at the end, so that we keep the order of the keys
+  int addChild(int node, char c) {
+    Node new_node;
+    new_node.c = c;
+    nodes.push_back(new_node);
+    int result = nodes.size() - 1;
+    if (nodes[node].child < 0) {
+      nodes[node].child = result;
+    } else {
+      int last = nodes[node].child;
+      while (nodes[last].sibling >= 0) last = nodes[last].sibling;
+      nodes[last].sibling = result;
+    }
+    return result;
+  }
+
+  int findChild(int node, char c) {
+    for (int child = nodes[node].child; child >= 0;
+         child = nodes[child].sibling) {
+      if (nodes[child].c == c) return child;
+    }
+    return -1;
+  }
+
+  template <class Callback>
+  void visit(int node, Callback& callback) {
+    if (nodes[node].value >= 0) callback(values[nodes[node].value]);
+    for (int child = nodes[node].child; child >= 0;
+         child = nodes[child].sibling) {
+      visit(child, callback);
+    }
+  }
+
+  static char toLower(char c) {
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+  }
+};
+
+}  // namespace telnet
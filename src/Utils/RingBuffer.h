@@ -0,0 +1,140 @@
+#pragma once
+#include "../TinyTelnetServerConfig.h"
+#include "Vector.h"
+
+namespace telnet {
+
+/**
+ * @brief Simple byte ring buffer with a fixed capacity. Reading and writing
+ * never blocks: we just process as much as fits or is available.
+ * @ingroup collections
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+
+class RingBuffer {
+ public:
+  /// Default constructor: call resize() to define the capacity
+  RingBuffer() = default;
+
+  /// Constructor which defines the capacity
+  RingBuffer(int size) { resize(size); }
+
+  /// Defines the capacity: any buffered data is lost
+  void resize(int size) {
+    buffer.resize(size);
+    clear();
+  }
+
+  /// Removes all data
+  void clear() {
+    read_pos = 0;
+    count = 0;
+  }
+
+  /// Max number of bytes which can be stored
+  int size() { return buffer.size(); }
+
+  /// Number of bytes which can be read
+  int available() { return count; }
+
+  /// Number of bytes which can be written
+  int availableForWrite() { return size() - count; }
+
+  /// Checks if there is no data
+  bool isEmpty() { return count == 0; }
+
+  /// Checks if the buffer is full
+  bool isFull() { return availableForWrite() == 0; }
+
+  /// Adds a single byte: returns false if the buffer is full
+  bool write(uint8_t value) {
+    if (isFull()) return false;
+    buffer[(read_pos + count) % size()] = value;
+    count++;
+    return true;
+  }
+
+  /// Adds as many bytes as fit and returns the number of written bytes
+  int write(const uint8_t* data, int len) {
+    int result = len < availableForWrite() ? len : availableForWrite();
+    for (int j = 0; j < result; j++) {
+      buffer[(read_pos + count + j) % size()] = data[j];
+    }
+    count += result;
+    return result;
+  }
+
+  /// Reads a single byte: returns -1 if there is no data
+  int read() {
+    if (isEmpty()) return -1;
+    uint8_t result = buffer[read_pos];
+    read_pos = (read_pos + 1) % size();
+    count--;
+    return result;
+  }
+
+  /// Reads up to len bytes and returns the number of read bytes
+  int readBytes(uint8_t* data, int len) {
+    int result = peekBytes(data, len);
+    consume(result);
+    return result;
+  }
+
+  /// Copies up to len bytes w/o removing them and returns the number of
+  /// copied bytes
+  int peekBytes(uint8_t* data, int len) {
+    int result = len < count ? len : count;
+    for (int j = 0; j < result; j++) {
+      data[j] = buffer[(read_pos + j) % size()];
+    }
+    return result;
+  }
+
+  /// Provides the byte at the indicated offset w/o removing it: -1 if not
+  /// available
+  int peek(int offset = 0) {
+    if (offset >= count) return -1;
+    return buffer[(read_pos + offset) % size()];
+  }
+
+  /// Provides the offset of the indicated byte starting from the indicated
+  /// offset or -1 if not found
+  int indexOf(uint8_t value, int start = 0) {
+    for (int j = start; j < count; j++) {
+      if (buffer[(read_pos + j) % size()] == value) return j;
+    }
+    return -1;
+  }
+
+  /// Removes the indicated number of bytes
+  void consume(int len) {
+    if (len > count) len = count;
+    if (len <= 0) return;
+    read_pos = (read_pos + len) % size();
+    count -= len;
+  }
+
+  /// Provides the offset of the last occurrence of the indicated byte or -1
+  /// if not found
+  int lastIndexOf(uint8_t value) {
+    for (int j = count - 1; j >= 0; j--) {
+      if (buffer[(read_pos + j) % size()] == value) return j;
+    }
+    return -1;
+  }
+
+  /// Removes the last written byte: returns false if the buffer is empty
+  bool removeLast() {
+    if (count == 0) return false;
+    count--;
+    return true;
+  }
+
+ protected:
+  Vector<uint8_t> buffer;
+  int read_pos = 0;
+  int count = 0;
+};
+
+}  // namespace telnet
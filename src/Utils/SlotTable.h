@@ -0,0 +1,85 @@
+#pragma once
+#include "../TinyTelnetServerConfig.h"
+
+namespace telnet {
+
+/**
+ * @brief Table with a fixed number of slots which is defined at compile
+ * time: the objects never move, so the slot index is stable for the lifetime
+ * of the entry. Acquiring and releasing a slot is O(1) because the free slots
+ * are managed in a free list and the used slots in a dense list which can be
+ * iterated w/o visiting the free slots.
+ * @ingroup collections
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <class T, int N>
+class SlotTable {
+ public:
+  SlotTable() { clear(); }
+
+  /// Provides the index of a free slot which is marked as used: returns -1
+  /// if all slots are used or the max size has been reached
+  int acquire() {
+    if (free_count == 0 || used_count >= max_size) return -1;
+    int slot = free_list[--free_count];
+    used_pos[slot] = used_count;
+    used[used_count++] = slot;
+    return slot;
+  }
+
+  /// Marks the slot as free
+  void release(int slot) {
+    if (slot < 0 || slot >= N || used_pos[slot] < 0) return;
+    // move the last used slot into the gap
+    int pos = used_pos[slot];
+    int last = used[--used_count];
+    used[pos] = last;
+    used_pos[last] = pos;
+    used_pos[slot] = -1;
+    free_list[free_count++] = slot;
+  }
+
+  /// Marks all slots as free
+  void clear() {
+    used_count = 0;
+    free_count = N;
+    for (int j = 0; j < N; j++) {
+      // we hand out the lowest slot first
+      free_list[j] = N - 1 - j;
+      used_pos[j] = -1;
+    }
+  }
+
+  /// Provides the object in the indicated slot
+  T& operator[](int slot) { return slots[slot]; }
+
+  /// Provides the slot index of the nth used slot (0 <= pos < size())
+  int usedSlot(int pos) { return used[pos]; }
+
+  /// Returns true if the slot is in use
+  bool isUsed(int slot) { return used_pos[slot] >= 0; }
+
+  /// Number of used slots
+  int size() { return used_count; }
+
+  /// Number of slots
+  int capacity() { return N; }
+
+  /// Limits the number of used slots (max is the capacity)
+  void setMaxSize(int size) { max_size = size < N ? size : N; }
+
+  /// Provides the max number of used slots
+  int maxSize() { return max_size; }
+
+ protected:
+  T slots[N];
+  int free_list[N];
+  int free_count = N;
+  int used[N];
+  int used_pos[N];
+  int used_count = 0;
+  int max_size = N;
+};
+
+}  // namespace telnet
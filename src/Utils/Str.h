@@ -6,7 +6,9 @@
 namespace telnet {
 
 /**
- * @brief String which keeps the data on the heap. We grow the allocated
+ * @brief String which manages its own memory: short strings (up to
+ * STR_INLINE_SIZE - 1 characters) are stored in the object itself and only
+ * longer strings are allocated on the heap. We grow the allocated
  * memory only if the copy source is not fitting.
  *
  * While it should be avoided to use a lot of heap allocatioins in
@@ -25,33 +27,35 @@ class Str : public StrView {
   friend class StrView;
 
  public:
-  Str() = default;
+  Str() { useInline(); }
 
   Str(int initialAllocatedLength) : StrView() {
-    maxlen = initialAllocatedLength;
-    is_const = false;
-    grow(maxlen);
+    useInline();
+    grow(initialAllocatedLength);
   }
 
   Str(const char *str) : StrView() {
-    if (str != nullptr) {
-      len = strlen(str);
-      maxlen = len;
-      grow(maxlen);
-      if (chars != nullptr) {
-        strcpy(chars, str);
-      }
-    }
+    useInline();
+    if (str != nullptr) set(str);
   }
 
   /// Convert StrView to Str
-  Str(StrView &source) : StrView() { set(source); }
+  Str(StrView &source) : StrView() {
+    useInline();
+    set(source);
+  }
 
   /// Copy constructor
-  Str(Str &source) : StrView() { set(source); }
+  Str(Str &source) : StrView() {
+    useInline();
+    set(source);
+  }
 
   /// Move constructor
-  Str(Str &&obj) { move(obj); }
+  Str(Str &&obj) {
+    useInline();
+    move(obj);
+  }
 
   /// Destructor
   ~Str() {
@@ -64,8 +68,7 @@ class Str : public StrView {
 
   /// Copy assingment
   Str &operator=(Str &obj) {
-    // assert(&obj!=nullptr);
-    set(obj.c_str());
+    if (&obj != this) set(obj.c_str());
     return *this;
   };
 
@@ -89,13 +92,14 @@ class Str : public StrView {
   void allocate(int len = -1) {
     int new_size = len < 0 ? maxlen : len;
     grow(new_size);
-    this->len = new_size;
+    this->len = new_size <= maxlen ? new_size : maxlen;
   }
 
   /// assigns a memory buffer
   void copyFrom(const char *source, int len, int maxlen = 0) {
-    this->maxlen = maxlen == 0 ? len : maxlen;
-    grow(this->maxlen);
+    grow(maxlen == 0 ? len : maxlen);
+    // we truncate if the memory is not available
+    if (len > this->maxlen) len = this->maxlen;
     if (this->chars != nullptr) {
       this->len = len;
       this->is_const = false;
@@ -106,7 +110,8 @@ class Str : public StrView {
 
   /// Fills the string with len chars
   void setChars(char c, int len) {
-    grow(this->maxlen);
+    grow(len);
+    if (len > this->maxlen) len = this->maxlen;
     if (this->chars != nullptr) {
       for (int j = 0; j < len; j++) {
         this->chars[j] = c;
@@ -135,6 +140,7 @@ class Str : public StrView {
     }
     // save result
     grow(new_size);
+    if (new_size > maxlen) return;
     strcpy(chars, result);
     this->len = strlen(temp);
   }
@@ -163,46 +169,130 @@ class Str : public StrView {
     this->len = result_idx;
   }
 
+  /// Removes the content: allocated heap memory is kept for reuse
   void clear() override {
-    len = 0;
-    maxlen = 0;
-    vector.resize(0);
-    chars = nullptr;
+    if (isOnHeapBuffer()) {
+      len = 0;
+      chars[0] = 0;
+    } else {
+      useInline();
+    }
   }
 
+  /// Exchanges the content: each string keeps its allocator
   void swap(Str &other) {
-    int tmp_len = len;
-    int tmp_maxlen = maxlen;
-    len = other.len;
-    maxlen = other.maxlen;
-    vector.swap(other.vector);
-    chars = vector.data();
-    other.chars = other.vector.data();
+    if (&other == this) return;
+    Str tmp;
+    tmp.vector.setAllocator(vector.getAllocator());
+    tmp.move(other);
+    other.move(*this);
+    move(tmp);
+  }
+
+  /// Exchanges the content with another string: the chars of a StrView which
+  /// is not a Str are copied, so that it never points to our inline buffer
+  void swap(StrView &other) override {
+    if (&other == this) return;
+    if (other.isOnHeap()) {
+      swap((Str &)other);
+      return;
+    }
+    if (other.isConst()) {
+      TELNET_LOGE("swap with the const string %s is not supported", other.c_str());
+      return;
+    }
+    Str tmp(*this);
+    set(other);
+    other.set(tmp.c_str());
+  }
+
+  /// Returns true if the string is stored in the object w/o heap
+  bool isInline() { return chars == inline_chars; }
+
+  /// Defines the allocator which is used if the string does not fit into
+  /// the inline buffer: an already allocated string is copied
+  void setAllocator(Allocator &allocator) {
+    Vector<char> tmp(allocator);
+    bool is_heap = isOnHeapBuffer();
+    if (is_heap) {
+      // we keep the current allocator if the memory is not available
+      if (!tmp.reserve(maxlen + 1)) return;
+      tmp.resize(maxlen + 1);
+      memcpy(tmp.data(), chars, len + 1);
+    }
+    // the old memory is released with tmp by the old allocator
+    Allocator& old_allocator = vector.getAllocator();
+    vector.swap(tmp);
+    vector.setAllocator(allocator);
+    tmp.setAllocator(old_allocator);
+    if (is_heap) chars = vector.data();
   }
 
  protected:
   Vector<char> vector;
+  char inline_chars[STR_INLINE_SIZE];
+
+  /// Uses the buffer in the object with an empty string
+  void useInline() {
+    inline_chars[0] = 0;
+    chars = inline_chars;
+    maxlen = STR_INLINE_SIZE - 1;
+    len = 0;
+    is_const = false;
+  }
+
+  bool isOnHeapBuffer() {
+    return chars != nullptr && chars == vector.data();
+  }
 
+  /// Takes over the content of the other string which is empty afterwards:
+  /// heap memory is passed on w/o copying if both strings use the same
+  /// allocator, otherwise it would be released by the wrong allocator
   Str &move(Str &other) {
-    swap(other);
-    other.clear();
+    if (&other == this) return *this;
+    if (other.isOnHeapBuffer() &&
+        &vector.getAllocator() == &other.vector.getAllocator()) {
+      vector.swap(other.vector);
+      chars = vector.data();
+      maxlen = other.maxlen;
+      len = other.len;
+      is_const = false;
+      other.vector.reset();
+    } else {
+      // short strings and strings from other allocators are copied
+      grow(other.len);
+      len = other.len <= maxlen ? other.len : maxlen;
+      memcpy(chars, other.chars, len);
+      chars[len] = 0;
+      other.vector.reset();
+    }
+    other.useInline();
     return *this;
   }
 
   bool grow(int newMaxLen) override {
-    bool grown = false;
     assert(newMaxLen < 1024 * 10);
     if (newMaxLen < 0) return false;
+    if (chars != nullptr && newMaxLen <= maxlen) return false;
 
-    if (chars == nullptr || newMaxLen > maxlen) {
-      grown = true;
-      // we use at minimum the defined maxlen
-      int newSize = newMaxLen > maxlen ? newMaxLen : maxlen;
-      vector.resize(newSize + 1);
-      chars = &vector[0];
-      maxlen = newSize;
+    // we use at minimum the defined maxlen
+    int newSize = newMaxLen > maxlen ? newMaxLen : maxlen;
+    if (newSize < STR_INLINE_SIZE && chars == nullptr) {
+      useInline();
+      return true;
+    }
+    bool is_heap = isOnHeapBuffer();
+    // we keep the current buffer if the memory is not available
+    if (!vector.reserve(newSize + 1)) return false;
+    vector.resize(newSize + 1);
+    if (!is_heap) {
+      // move the inline content to the heap
+      if (chars != nullptr) memcpy(vector.data(), chars, len);
+      vector[len] = 0;
     }
-    return grown;
+    chars = vector.data();
+    maxlen = newSize;
+    return true;
   }
 
   void urlEncodeChar(char c, char *result, int maxLen) {
@@ -59,7 +59,9 @@ class StrView {
         this->maxlen = this->len;
         this->chars = (char*)alt;
       } else {
-        /// if the Str is an external buffer we need to copy
+        /// if the Str is an external buffer we need to copy: it is truncated
+        /// if it could not grow
+        if (this->len > this->maxlen) this->len = this->maxlen;
         strncpy(this->chars, alt, this->maxlen);
         this->chars[len] = 0;
       }
@@ -74,7 +76,9 @@ class StrView {
       /// if the Str is a const we replace the pointer
       this->chars = alt.chars;
     } else {
-      /// if the Str is an external buffer we need to copy
+      /// if the Str is an external buffer we need to copy: it is truncated
+      /// if it could not grow
+      if (this->len > this->maxlen) this->len = this->maxlen;
       strncpy(this->chars, alt.chars, this->maxlen);
       this->chars[len] = 0;
     }
@@ -129,7 +133,7 @@ class StrView {
   virtual void add(int value) {
     if (!this->isConst()) {
       grow(this->length() + 11);
-      snprintf(this->chars + len, 10, "%d", value);
+      snprintf(this->chars + len, maxlen - len + 1, "%d", value);
       len = strlen(chars);
     }
   }
@@ -149,6 +153,7 @@ class StrView {
       int append_len = strlen(append);
       grow(this->length() + append_len + 1);
       int n = (len + append_len) < maxlen - 1 ? append_len : maxlen - len - 1;
+      if (n < 0) n = 0;
       strncat(chars, append, n);
       chars[len + n] = 0;
       len = strlen(chars);
@@ -177,6 +182,15 @@ class StrView {
     return strncmp(this->chars, str, len) == 0;
   }
 
+  /// checks if the string starts with the indicated substring ignoring the
+  /// case
+  virtual bool startsWithIgnoreCase(const char* str) {
+    if (str == nullptr) return false;
+    int startlen = strlen(str);
+    if (startlen > len) return false;
+    return strncmp_i(this->chars, str, startlen) == 0;
+  }
+
   /// checks if the string ends with the indicated substring
   virtual bool endsWith(const char* str) {
     if (str == nullptr) return false;
@@ -406,6 +420,7 @@ class StrView {
         int len_to_replace = strlen(toReplace);
         insert_len = len_replaced - len_to_replace;
         grow(this->length() + insert_len);
+        if (this->length() + insert_len > maxlen) return false;
         // save remainder and create gap
         memmove(this->chars + pos + len_replaced,
                 this->chars + pos + len_to_replace,
@@ -481,6 +496,7 @@ class StrView {
     if (end > start) {
       int len = end - start;
       grow(len);
+      if (len > maxlen) len = maxlen;
       if (this->chars != nullptr) {
         strncpy(this->chars, from + start, len);
         this->chars[len] = 0;
@@ -554,6 +570,7 @@ class StrView {
     if (!isConst()) {
       int insert_len = strlen(str);
       grow(this->length() + insert_len);
+      if (this->length() + insert_len > maxlen) return;
       int move_len = this->len - pos + 1;
       memmove(chars + pos + insert_len, chars + pos, move_len);
       strncpy(chars + pos, str, insert_len);
@@ -0,0 +1,126 @@
+#pragma once
+#include "../TinyTelnetServerConfig.h"
+
+namespace telnet {
+
+/**
+ * @brief Hashed timer wheel for N timers which are identified by their index
+ * (0 <= id < N). The timers are kept in intrusive lists per bucket, so
+ * scheduling and cancelling is O(1) and advancing the wheel by one tick
+ * only visits the timers of a single bucket. Timers which are more than one
+ * revolution in the future just stay in their bucket until their tick has
+ * come. The wheel only works with the time which has elapsed since the last
+ * advance, so it is not affected by the wraparound of millis().
+ * @ingroup collections
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <int N, int SLOTS = IDLE_TIMER_SLOTS>
+class TimerWheel {
+ public:
+  TimerWheel() { clear(); }
+
+  /// Defines the start time and the resolution of the timers in ms
+  void begin(unsigned long now, int tick_ms = IDLE_TIMER_TICK_MS) {
+    clear();
+    this->tick_ms = tick_ms > 0 ? tick_ms : 1;
+    current_tick = 0;
+    last_time = now;
+  }
+
+  /// Removes all timers
+  void clear() {
+    for (int j = 0; j < SLOTS; j++) buckets[j] = -1;
+    for (int j = 0; j < N; j++) {
+      next[j] = prev[j] = -1;
+      bucket_of[j] = -1;
+    }
+  }
+
+  /// (Re)schedules the timer to expire at the indicated time in ms
+  void schedule(int id, unsigned long time) {
+    cancel(id);
+    // expired timers are reported with the next tick
+    long wait = (long)(time - last_time);
+    unsigned long tick = current_tick + 1;
+    if (wait > tick_ms) tick = current_tick + (wait + tick_ms - 1) / tick_ms;
+    expiry_tick[id] = tick;
+    int bucket = tick % SLOTS;
+    bucket_of[id] = bucket;
+    prev[id] = -1;
+    next[id] = buckets[bucket];
+    if (next[id] >= 0) prev[next[id]] = id;
+    buckets[bucket] = id;
+  }
+
+  /// Removes the timer
+  void cancel(int id) {
+    int bucket = bucket_of[id];
+    if (bucket < 0) return;
+    if (prev[id] >= 0) {
+      next[prev[id]] = next[id];
+    } else {
+      buckets[bucket] = next[id];
+    }
+    if (next[id] >= 0) prev[next[id]] = prev[id];
+    next[id] = prev[id] = -1;
+    bucket_of[id] = -1;
+  }
+
+  /// Returns true if the timer is scheduled
+  bool isScheduled(int id) { return bucket_of[id] >= 0; }
+
+  /// Provides the time in ms until the next bucket with timers is due, so
+  /// that we can sleep until then (-1 = no timers). The timers in the bucket
+  /// might belong to a later revolution, so we might wake up too early but
+  /// never too late.
+  long nextExpiry(unsigned long now) {
+    for (int j = 1; j <= SLOTS; j++) {
+      if (buckets[(current_tick + j) % SLOTS] < 0) continue;
+      long result = (long)(last_time + j * tick_ms - now);
+      return result > 0 ? result : 0;
+    }
+    return -1;
+  }
+
+  /// Advances the wheel to the indicated time and calls the callback with
+  /// the id of each expired timer. The timer is removed before the callback
+  /// is called, so it can be rescheduled in the callback.
+  template <class Callback>
+  void expire(unsigned long now, Callback callback) {
+    if ((long)(now - last_time) < tick_ms) return;
+    unsigned long ticks = (now - last_time) / tick_ms;
+    last_time += ticks * tick_ms;
+    // we do not need to visit more than one revolution
+    if (ticks > (unsigned long)SLOTS) {
+      current_tick += ticks - SLOTS;
+      ticks = SLOTS;
+    }
+    while (ticks-- > 0) {
+      current_tick++;
+      int id = buckets[current_tick % SLOTS];
+      while (id >= 0) {
+        int next_id = next[id];
+        if ((long)(expiry_tick[id] - current_tick) <= 0) {
+          cancel(id);
+          callback(id);
+        }
+        id = next_id;
+      }
+    }
+  }
+
+ protected:
+  int buckets[SLOTS];
+  int next[N];
+  int prev[N];
+  int bucket_of[N];
+  unsigned long expiry_tick[N];
+  /// ticks since begin()
+  unsigned long current_tick = 0;
+  /// time in ms of the current tick
+  unsigned long last_time = 0;
+  int tick_ms = IDLE_TIMER_TICK_MS;
+};
+
+}  // namespace telnet
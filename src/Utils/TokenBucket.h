@@ -0,0 +1,75 @@
+#pragma once
+#include "../TinyTelnetServerConfig.h"
+#include "Arduino.h"
+
+namespace telnet {
+
+/**
+ * @brief Token bucket which limits a rate (e.g. commands or bytes per
+ * second): the bucket is refilled with rate tokens per second up to the
+ * burst size. The costs are consumed after the fact, so the bucket can get
+ * into debt which must be paid back before the next tokens are available.
+ * This way the average rate is kept even if the cost of an action is only
+ * known after it has been executed. A rate of 0 means unlimited.
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class TokenBucket {
+ public:
+  /// Defines the rate in tokens per second and the max number of tokens (0 =
+  /// rate): the bucket is filled
+  void setRate(unsigned long rate, unsigned long burst = 0) {
+    this->rate = rate;
+    this->burst = burst > 0 ? burst : rate;
+    reset(millis());
+  }
+
+  /// Fills the bucket
+  void reset(unsigned long now) {
+    tokens = (int64_t)burst * 1000;
+    last_time = now;
+  }
+
+  /// Returns true if the rate is limited
+  bool isLimited() { return rate > 0; }
+
+  /// Removes the indicated number of tokens: the bucket can get into debt
+  void consume(unsigned long count, unsigned long now) {
+    if (!isLimited() || count == 0) return;
+    refill(now);
+    tokens -= (int64_t)count * 1000;
+  }
+
+  /// Returns true if tokens are available (and the debt has been paid back)
+  bool isAvailable(unsigned long now) {
+    if (!isLimited()) return true;
+    refill(now);
+    return tokens > 0;
+  }
+
+  /// Provides the number of available tokens (negative = debt)
+  long available(unsigned long now) {
+    if (!isLimited()) return 0;
+    refill(now);
+    return tokens / 1000;
+  }
+
+ protected:
+  unsigned long rate = 0;
+  unsigned long burst = 0;
+  /// 1/1000 tokens, so that we can refill per ms w/o rounding errors
+  int64_t tokens = 0;
+  unsigned long last_time = 0;
+
+  void refill(unsigned long now) {
+    unsigned long elapsed = now - last_time;
+    if (elapsed == 0) return;
+    last_time = now;
+    int64_t max = (int64_t)burst * 1000;
+    tokens += (int64_t)elapsed * rate;
+    if (tokens > max) tokens = max;
+  }
+};
+
+}  // namespace telnet
@@ -4,8 +4,10 @@
 #include "InitializerList.h"
 #endif
 #include <assert.h>
+#include <string.h>
 
 #include "Allocator.h"
+#include "Move.h"
 
 namespace telnet {
 
@@ -13,6 +15,10 @@ namespace telnet {
  * @brief Vector implementation which provides the most important methods as
  * defined by std::vector. This class it is quite handy to have and most of the
  * times quite better then dealing with raw c arrays.
+ *
+ * The capacity grows geometrically, so adding N elements is linear. All
+ * entries up to the capacity are constructed by the Allocator, so the
+ * elements are moved by (move) assignment when the array is relocated.
  * @ingroup collections
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -107,28 +113,46 @@ class Vector {
   Vector(int size, T value, Allocator &allocator = DefaultAllocator) {
     setAllocator(allocator);
     resize(size);
-    for (int j = 0; j < size; j++) {
+    for (int j = 0; j < len; j++) {
       p_data[j] = value;
     }
   }
 
-  /// Move constructor
+  /// Move constructor: the elements of a scoped allocator (e.g. an arena)
+  /// are moved into memory of the DefaultAllocator
   Vector(Vector<T> &&moveFrom) {
+    if (moveFrom.p_allocator->isScoped()) {
+      moveElements(moveFrom);
+      return;
+    }
+    p_allocator = moveFrom.p_allocator;
     swap(moveFrom);
     moveFrom.clear();
   };
 
-  /// Move operator
+  /// Move operator: we only exchange the memory if no scoped allocator (e.g.
+  /// an arena) is involved, so that each vector keeps its allocator
   Vector &operator=(Vector &&moveFrom) {
+    if (this == &moveFrom) return *this;
+    if (moveFrom.p_allocator->isScoped() || p_allocator->isScoped()) {
+      moveElements(moveFrom);
+      return *this;
+    }
+    Allocator *tmp = p_allocator;
+    p_allocator = moveFrom.p_allocator;
+    moveFrom.p_allocator = tmp;
     swap(moveFrom);
     moveFrom.clear();
     return *this;
   }
 
-  /// copy constructor
+  /// copy constructor: copies of a vector of a scoped allocator (e.g. an
+  /// arena) use the DefaultAllocator
   Vector(Vector<T> &copyFrom) {
-    this->p_allocator = copyFrom.p_allocator;
-    resize_internal(copyFrom.size(), false);
+    this->p_allocator = copyFrom.p_allocator->isScoped()
+                            ? &DefaultAllocator
+                            : copyFrom.p_allocator;
+    if (!resize_internal(copyFrom.size(), false)) return;
     for (int j = 0; j < copyFrom.size(); j++) {
       p_data[j] = copyFrom[j];
     }
@@ -138,7 +162,7 @@ class Vector {
   /// convert from c array
   template <typename TT, int N>
   Vector(TT (&a)[N]) {
-    resize_internal(N, false);
+    if (!resize_internal(N, false)) return;
     for (int j = 0; j < N; j++) {
       p_data[j] = a[j];
     }
@@ -147,7 +171,7 @@ class Vector {
 
   /// copy operator
   Vector<T> &operator=(Vector<T> &copyFrom) {
-    resize_internal(copyFrom.size(), false);
+    if (!resize_internal(copyFrom.size(), false)) return *this;
     for (int j = 0; j < copyFrom.size(); j++) {
       p_data[j] = copyFrom[j];
     }
@@ -158,8 +182,8 @@ class Vector {
   /// legacy constructor with pointer range
   Vector(T *from, T *to, Allocator &allocator = DefaultAllocator) {
     this->p_allocator = &allocator;
+    if (!resize_internal(to - from, false)) return;
     this->len = to - from;
-    resize_internal(this->len, false);
     for (size_t j = 0; j < this->len; j++) {
       p_data[j] = from[j];
     }
@@ -170,6 +194,9 @@ class Vector {
 
   void setAllocator(Allocator &allocator) { p_allocator = &allocator; }
 
+  /// Provides the allocator which is used for the elements
+  Allocator &getAllocator() { return *p_allocator; }
+
   void clear() { len = 0; }
 
   int size() { return len; }
@@ -177,37 +204,56 @@ class Vector {
   bool empty() { return size() == 0; }
 
   void push_back(T &&value) {
-    resize_internal(len + 1, true);
-    p_data[len] = value;
+    if (!grow(len + 1)) return;
+    p_data[len] = stl::move(value);
     len++;
   }
 
   void push_back(T &value) {
-    resize_internal(len + 1, true);
+    if (!grow(len + 1)) return;
     p_data[len] = value;
     len++;
   }
 
-  void push_front(T &value) {
-    resize_internal(len + 1, true);
-    // memmove(p_data,p_data+1,len*sizeof(T));
-    for (int j = len; j >= 0; j--) {
-      p_data[j + 1] = p_data[j];
+  /// Adds a new element at the end which is constructed from the arguments:
+  /// if the memory is not available, we return a dummy entry which is not
+  /// part of the vector
+  template <class... Args>
+  T &emplace_back(Args &&...args) {
+    if (!grow(len + 1)) {
+      static T dummy;
+      dummy = T(stl::forward<Args>(args)...);
+      return dummy;
     }
+#if defined(NO_INPLACE_INIT_SUPPORT)
+    p_data[len] = T(stl::forward<Args>(args)...);
+#else
+    p_data[len].~T();
+    new (&p_data[len]) T(stl::forward<Args>(args)...);
+#endif
+    return p_data[len++];
+  }
+
+  void push_front(T &value) {
+    if (!grow(len + 1)) return;
+    shiftRight();
     p_data[0] = value;
     len++;
   }
 
   void push_front(T &&value) {
-    resize_internal(len + 1, true);
-    // memmove(p_data,p_data+1,len*sizeof(T));
-    for (int j = len; j >= 0; j--) {
-      p_data[j + 1] = p_data[j];
-    }
-    p_data[0] = value;
+    if (!grow(len + 1)) return;
+    shiftRight();
+    p_data[0] = stl::move(value);
     len++;
   }
 
+  /// Makes sure that the capacity is at least the indicated number of
+  /// elements: returns false if the memory is not available
+  bool reserve(int capacity) {
+    return capacity <= bufferLen || resize_internal(capacity, true);
+  }
+
   void pop_back() {
     if (len > 0) {
       len--;
@@ -218,7 +264,7 @@ class Vector {
 
   void assign(iterator v1, iterator v2) {
     size_t newLen = v2 - v1;
-    resize_internal(newLen, false);
+    if (!resize_internal(newLen, false)) return;
     this->len = newLen;
     int pos = 0;
     for (auto ptr = v1; ptr != v2; ptr++) {
@@ -227,7 +273,7 @@ class Vector {
   }
 
   void assign(size_t number, T value) {
-    resize_internal(number, false);
+    if (!resize_internal(number, false)) return;
     this->len = number;
     for (int j = 0; j < number; j++) {
       p_data[j] = value;
@@ -276,7 +322,7 @@ class Vector {
 
   bool resize(int newSize) {
     int oldSize = this->len;
-    resize_internal(newSize, true);
+    if (!resize_internal(newSize, true)) return false;
     this->len = newSize;
     return this->len != oldSize;
   }
@@ -292,20 +338,13 @@ class Vector {
 
   // removes a single element
   void erase(int pos) {
-    if (pos < len) {
-      int lenToEnd = len - pos - 1;
-      // call destructor on data to be erased
-      p_data[pos].~T();
+    if (pos >= 0 && pos < len) {
       // shift values by 1 position
-      memmove((void *)&p_data[pos], (void *)(&p_data[pos + 1]),
-              lenToEnd * sizeof(T));
-
-      // make sure that we have a valid object at the end
-#if defined(NO_INPLACE_INIT_SUPPORT)
+      for (int j = pos; j < len - 1; j++) {
+        p_data[j] = stl::move(p_data[j + 1]);
+      }
+      // release the resources of the last entry
       p_data[len - 1] = T();
-#else
-      new (&(p_data[len - 1])) T();
-#endif
       len--;
     }
   }
@@ -340,9 +379,9 @@ class Vector {
 
   void reset() {
     clear();
-    shrink_to_fit();
-    deleteArray(p_data, size());  // delete [] this->p_data;
+    deleteArray(p_data, bufferLen);  // delete [] this->p_data;
     p_data = nullptr;
+    bufferLen = 0;
   }
 
  protected:
@@ -351,27 +390,66 @@ class Vector {
   T *p_data = nullptr;
   Allocator *p_allocator = &DefaultAllocator;
 
-  void resize_internal(int newSize, bool copy, bool shrink = false) {
-    if (newSize <= 0) return;
+  /// Increases the capacity geometrically (by 50%), so that adding
+  /// elements one by one is linear
+  bool grow(int minSize) {
+    if (minSize <= bufferLen && p_data != nullptr) return true;
+    int newSize = bufferLen + bufferLen / 2;
+    if (newSize < 4) newSize = 4;
+    if (newSize < minSize) newSize = minSize;
+    return resize_internal(newSize, true);
+  }
+
+  /// Moves all elements by one position to the right: the capacity must be
+  /// bigger then len
+  void shiftRight() {
+    for (int j = len; j > 0; j--) {
+      p_data[j] = stl::move(p_data[j - 1]);
+    }
+  }
+
+  /// Reallocates the array: if the memory is not available we keep the old
+  /// array and return false
+  bool resize_internal(int newSize, bool copy, bool shrink = false) {
+    if (newSize <= 0) return true;
     if (newSize > bufferLen || this->p_data == nullptr || shrink) {
+      T *newData = newArray(newSize);  // new T[newSize+1];
+      if (newData == nullptr) return false;
       T *oldData = p_data;
       int oldBufferLen = this->bufferLen;
-      p_data = newArray(newSize);  // new T[newSize+1];
-      assert(p_data != nullptr);
+      p_data = newData;
       this->bufferLen = newSize;
       if (oldData != nullptr) {
         if (copy && this->len > 0) {
           // save existing data
-          memmove((void *)p_data, (void *)oldData, len * sizeof(T));
-          // clear to prevent double release
-          memset((void *)oldData, 0, len * sizeof(T));
-        }
-        if (shrink) {
-          cleanup(oldData, newSize, oldBufferLen);
+          relocate(p_data, oldData, len < newSize ? len : newSize);
         }
         deleteArray(oldData, oldBufferLen);  // delete [] oldData;
       }
     }
+    return true;
+  }
+
+  /// Moves the elements into our own memory and clears the source
+  void moveElements(Vector<T> &from) {
+    if (!resize_internal(from.size(), false)) return;
+    for (int j = 0; j < from.size(); j++) p_data[j] = stl::move(from[j]);
+    this->len = from.size();
+    from.clear();
+  }
+
+  /// Moves the elements to the new array: the old elements stay valid, so
+  /// that they can be destructed
+  template <class TT = T>
+  static typename stl::enable_if<stl::is_trivially_copyable<TT>::value>::type
+  relocate(T *to, T *from, int count) {
+    memcpy((void *)to, (void *)from, count * sizeof(T));
+  }
+
+  template <class TT = T>
+  static typename stl::enable_if<!stl::is_trivially_copyable<TT>::value>::type
+  relocate(T *to, T *from, int count) {
+    for (int j = 0; j < count; j++) to[j] = stl::move(from[j]);
   }
 
   T *newArray(int newSize) {
@@ -391,12 +469,6 @@ class Vector {
     delete[] oldData;
 #endif
   }
-
-  void cleanup(T *data, int from, int to) {
-    for (int j = from; j < to; j++) {
-      data[j].~T();
-    }
-  }
 };
 
 }  // namespace telnet
\ No newline at end of file
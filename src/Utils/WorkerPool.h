@@ -0,0 +1,272 @@
+#pragma once
+#include "../TinyTelnetServerConfig.h"
+#include "Arduino.h"
+#include "Logger.h"
+#include "RingBuffer.h"
+#include "Vector.h"
+
+#if USE_WORKER_THREADS
+#include <atomic>
+#if defined(ESP32) && defined(ARDUINO)
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#else
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace telnet {
+
+/**
+ * @brief Simple mutex: a FreeRTOS semaphore on the ESP32 and a std::mutex
+ * everywhere else
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class Mutex {
+ public:
+#if defined(ESP32) && defined(ARDUINO)
+  Mutex() { handle = xSemaphoreCreateMutex(); }
+  ~Mutex() { vSemaphoreDelete(handle); }
+  void lock() { xSemaphoreTake(handle, portMAX_DELAY); }
+  void unlock() { xSemaphoreGive(handle); }
+
+ protected:
+  SemaphoreHandle_t handle;
+#else
+  void lock() { mutex.lock(); }
+  void unlock() { mutex.unlock(); }
+
+ protected:
+  std::mutex mutex;
+#endif
+};
+
+/**
+ * @brief Locks the mutex for the lifetime of the object
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class LockGuard {
+ public:
+  LockGuard(Mutex& mutex) : mutex(mutex) { mutex.lock(); }
+  ~LockGuard() { mutex.unlock(); }
+
+ protected:
+  Mutex& mutex;
+};
+
+/**
+ * @brief Print which is written by a worker thread and read by the thread
+ * which owns the session: if the buffer is full the worker waits until the
+ * data has been consumed.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class WorkerOutput : public Print {
+ public:
+  WorkerOutput(int size = WORKER_OUTPUT_SIZE) { buffer.resize(size); }
+
+  using Print::write;
+
+  size_t write(uint8_t value) override { return write(&value, 1); }
+
+  size_t write(const uint8_t* data, size_t len) override {
+    size_t result = 0;
+    while (result < len) {
+      {
+        LockGuard guard(mutex);
+        // the session is gone: we just discard the data
+        if (is_closed) return len;
+        result += buffer.write(data + result, len - result);
+      }
+      if (result < len) delay(1);
+    }
+    return result;
+  }
+
+  /// Provides the data for the session
+  int readBytes(uint8_t* data, int len) {
+    LockGuard guard(mutex);
+    return buffer.readBytes(data, len);
+  }
+
+  /// Provides the data for the session w/o removing it
+  int peekBytes(uint8_t* data, int len) {
+    LockGuard guard(mutex);
+    return buffer.peekBytes(data, len);
+  }
+
+  /// Removes the indicated number of bytes which have been passed on
+  void consume(int len) {
+    LockGuard guard(mutex);
+    buffer.consume(len);
+  }
+
+  /// Number of bytes which are waiting to be read
+  int available() {
+    LockGuard guard(mutex);
+    return buffer.available();
+  }
+
+  /// The data is not needed any more: unblocks the writer
+  void close() {
+    LockGuard guard(mutex);
+    is_closed = true;
+    buffer.clear();
+  }
+
+ protected:
+  Mutex mutex;
+  RingBuffer buffer;
+  bool is_closed = false;
+};
+
+/**
+ * @brief Pool of worker threads which execute jobs: FreeRTOS tasks on the
+ * ESP32 and std::thread everywhere else.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class WorkerPool {
+ public:
+  /// Unit of work which is executed by a worker
+  struct Job {
+    virtual ~Job() = default;
+    /// executed by the worker thread
+    virtual void run() = 0;
+    /// set by the worker when run() has ended
+    std::atomic<bool> is_done{false};
+  };
+
+  ~WorkerPool() { end(); }
+
+  /// Starts the indicated number of workers
+  bool begin(int count = WORKER_THREADS) {
+    if (is_active) return true;
+    is_active = true;
+#if defined(ESP32) && defined(ARDUINO)
+    queue = xQueueCreate(WORKER_QUEUE_SIZE, sizeof(Job*));
+    for (int j = 0; j < count; j++) {
+      TaskHandle_t task;
+      if (xTaskCreatePinnedToCore(worker, "telnet-worker", WORKER_STACK_SIZE,
+                                  this, WORKER_PRIORITY, &task,
+                                  WORKER_CORE) == pdPASS) {
+        running++;
+      }
+    }
+#else
+    for (int j = 0; j < count; j++) {
+      threads.push_back(new std::thread(worker, this));
+      running++;
+    }
+#endif
+    TELNET_LOGI("workers: %d", (int)running);
+    return running > 0;
+  }
+
+  /// Stops the workers after they have finished their current job: the
+  /// queued jobs are not executed
+  void end() {
+    if (!is_active) return;
+    is_active = false;
+#if defined(ESP32) && defined(ARDUINO)
+    Job* stop = nullptr;
+    xQueueReset(queue);
+    for (int j = 0; j < running; j++) xQueueSend(queue, &stop, portMAX_DELAY);
+    while (running > 0) delay(1);
+    vQueueDelete(queue);
+    queue = nullptr;
+#else
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      jobs.clear();
+    }
+    available.notify_all();
+    for (auto thread : threads) {
+      thread->join();
+      delete thread;
+    }
+    threads.clear();
+    running = 0;
+#endif
+  }
+
+  /// Adds a job: returns false if the queue is full
+  bool submit(Job* job) {
+    if (!is_active) return false;
+#if defined(ESP32) && defined(ARDUINO)
+    return xQueueSend(queue, &job, 0) == pdTRUE;
+#else
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      if (jobs.size() >= WORKER_QUEUE_SIZE) return false;
+      jobs.push_back(job);
+    }
+    available.notify_one();
+    return true;
+#endif
+  }
+
+  /// Returns true if the workers have been started
+  bool isActive() { return is_active; }
+
+  /// Provides the job which is executed by the calling thread: nullptr if
+  /// the calling thread is not a worker
+  static Job*& currentJob() {
+    static thread_local Job* job = nullptr;
+    return job;
+  }
+
+ protected:
+  std::atomic<bool> is_active{false};
+  std::atomic<int> running{0};
+#if defined(ESP32) && defined(ARDUINO)
+  QueueHandle_t queue = nullptr;
+
+  static void worker(void* arg) {
+    WorkerPool* self = (WorkerPool*)arg;
+    Job* job = nullptr;
+    while (xQueueReceive(self->queue, &job, portMAX_DELAY) == pdTRUE) {
+      if (job == nullptr) break;
+      self->execute(job);
+    }
+    self->running--;
+    vTaskDelete(nullptr);
+  }
+#else
+  std::mutex mutex;
+  std::condition_variable available;
+  Vector<Job*> jobs;
+  Vector<std::thread*> threads;
+
+  static void worker(WorkerPool* self) {
+    while (true) {
+      Job* job = nullptr;
+      {
+        std::unique_lock<std::mutex> lock(self->mutex);
+        self->available.wait(
+            lock, [self] { return !self->is_active || self->jobs.size() > 0; });
+        if (!self->is_active) break;
+        job = self->jobs[0];
+        self->jobs.pop_front();
+      }
+      self->execute(job);
+    }
+  }
+#endif
+
+  void execute(Job* job) {
+    currentJob() = job;
+    job->run();
+    currentJob() = nullptr;
+    job->is_done = true;
+  }
+};
+
+}  // namespace telnet
+
+#endif
@@ -0,0 +1,44 @@
+/***
+ * @file test-epoll.ino
+ * @brief Desktop sketch which uses the native epoll backend: only the
+ * sessions which got ready are served and the loop blocks in epoll_wait()
+ * until a client sends data or the next idle timer is due. Connect with
+ * many telnet clients (e.g. telnet localhost 9023) and call ping.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+// include first: the EpollServer defines MAX_CLIENTS
+#include "Linux/EpollServer.h"
+#include "TinyTelnetServer.h"
+
+// port 23 needs root privileges on Linux: so we use a different port
+const int port = 9023;
+EpollServer epoll(port);
+TinyTelnetServer<EpollServer, EpollClient> server(epoll);
+
+// Callback function for the ping command
+bool ping(telnet::Str& cmd, telnet::Vector<telnet::Str> parameters, Print& out,
+          TinySerialServer* self) {
+  out.println(">pong");
+  out.println();
+  return true;
+}
+
+void setup() {
+  Serial.begin(115200);
+  // setup logger
+  TinyTelnetLogger.begin(Serial, TinyTelnetLogLevel::Info);
+
+  // register a commands
+  server.addCommand("ping", ping, ": (no parameters) - just replys with pong");
+  // close sessions w/o input after 1 minute: the loop wakes up when the
+  // next idle timer is due
+  server.setIdleTimeout(60000);
+
+  // start server
+  server.begin();
+  Serial.print("Connect with telnet localhost ");
+  Serial.println(port);
+}
+
+void loop() { server.processCommand(); }
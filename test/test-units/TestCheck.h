@@ -0,0 +1,43 @@
+#pragma once
+/***
+ * @file TestCheck.h
+ * @brief Minimal check support for the unit test sketches: the failed
+ * checks are reported and the sketch exits with 1 if any check failed.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+#include "Arduino.h"
+
+int failures = 0;
+#define CHECK(cond) check(cond, #cond, __LINE__)
+
+void check(bool ok, const char* expr, int line) {
+  if (ok) return;
+  failures++;
+  Serial.print("FAILED line ");
+  Serial.print(line);
+  Serial.print(": ");
+  Serial.println(expr);
+}
+
+/// Reports the result and ends the sketch
+void endChecks() {
+  Serial.print("failures: ");
+  Serial.println(failures);
+  exit(failures == 0 ? 0 : 1);
+}
+
+/// Collects the output, so that it can be checked
+struct Capture : public Print {
+  char data[256] = {0};
+  int len = 0;
+  size_t write(uint8_t value) override {
+    if (len >= (int)sizeof(data) - 1) return 0;
+    data[len++] = value;
+    return 1;
+  }
+  void clear() {
+    len = 0;
+    memset(data, 0, sizeof(data));
+  }
+};
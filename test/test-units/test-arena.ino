@@ -0,0 +1,69 @@
+/***
+ * @file test-arena.ino
+ * @brief Checks the ArenaAllocator: marks, the release of the last block,
+ * the fallback and that copies and moves of vectors do not keep the memory
+ * of the arena.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+#include "Arduino.h"
+#include "Utils/ArenaAllocator.h"
+#include "Utils/Str.h"
+#include "TestCheck.h"
+
+using namespace telnet;
+
+void setup() {
+  Serial.begin(115200);
+  ArenaAllocator arena(256);
+  void* first = arena.allocate(10);
+  CHECK(first != nullptr && arena.used() == 16);
+  size_t mark = arena.mark();
+  void* second = arena.allocate(100);
+  CHECK(arena.used() == 16 + 104);
+  // the last block is given back immediately
+  arena.free(second);
+  CHECK(arena.used() == mark);
+  CHECK(arena.allocate(100) == second);
+  // the fallback is used when the region is full
+  void* big = arena.allocate(300);
+  CHECK(big != nullptr && arena.fallbackCount() == 1);
+  arena.free(big);
+  arena.reset(mark);
+  CHECK(arena.used() == mark);
+  arena.reset();
+  CHECK(arena.used() == 0);
+
+  // vectors which are moved or copied out of the arena survive the reset
+  ArenaAllocator scope(1024);
+  Vector<Str> stored;
+  Vector<Str> copied_list;
+  {
+    Vector<Str> parameters(scope);
+    for (int j = 0; j < 3; j++) {
+      Str& parameter = parameters.emplace_back();
+      parameter.setAllocator(scope);
+      parameter = "a parameter which does not fit inline";
+    }
+    Vector<Str> copy(parameters);
+    copied_list = copy;
+    CHECK(&copy.getAllocator() == &DefaultAllocator);
+    stored = stl::move(parameters);
+    CHECK(&stored.getAllocator() == &DefaultAllocator);
+    CHECK(parameters.size() == 0);
+  }
+  scope.reset();
+  Vector<Str> overwrite(scope);
+  for (int j = 0; j < 3; j++) {
+    Str& str = overwrite.emplace_back();
+    str.setAllocator(scope);
+    str = "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx";
+  }
+  CHECK(stored.size() == 3);
+  CHECK(stored[2] == "a parameter which does not fit inline");
+  CHECK(copied_list[2] == "a parameter which does not fit inline");
+
+  endChecks();
+}
+
+void loop() {}
@@ -0,0 +1,53 @@
+/***
+ * @file test-arguments.ino
+ * @brief Checks the in place tokenizer of the command line: both syntax
+ * variants, quoted parameters and invalid input.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+#include "Utils/Arguments.h"
+#include "TestCheck.h"
+
+using namespace telnet;
+
+void setup() {
+  Serial.begin(115200);
+  Arguments args;
+  char line1[] = "led 5  on";
+  CHECK(args.parse(line1));
+  CHECK(StrView(args.cmd()) == "led");
+  CHECK(args.size() == 2);
+  CHECK(args[0] == "5" && args[1] == "on");
+
+  // function syntax with quoted parameters
+  char line2[] = "say(1, 'x, y' , \"z\")";
+  CHECK(args.parse(line2));
+  CHECK(StrView(args.cmd()) == "say");
+  CHECK(args.size() == 3);
+  CHECK(args[0] == "1" && args[1] == "x, y" && args[2] == "z");
+
+  char line3[] = "echo \"hello world\" end";
+  CHECK(args.parse(line3));
+  CHECK(args.size() == 2);
+  CHECK(args[0] == "hello world" && args[1] == "end");
+
+  // no parameters
+  char line4[] = "help";
+  CHECK(args.parse(line4));
+  CHECK(args.size() == 0);
+
+  // invalid commands
+  char line5[] = " help";
+  CHECK(!args.parse(line5));
+  char line6[] = "1help";
+  CHECK(!args.parse(line6));
+
+  // too many parameters
+  char line7[MAX_ARGUMENTS * 2 + 8] = "cmd";
+  for (int j = 0; j <= MAX_ARGUMENTS; j++) strcat(line7, " x");
+  CHECK(!args.parse(line7));
+
+  endChecks();
+}
+
+void loop() {}
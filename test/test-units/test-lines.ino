@@ -0,0 +1,51 @@
+/***
+ * @file test-lines.ino
+ * @brief Checks the incremental assembly of the input lines in the ring
+ * buffer: lines which wrap around the end of the buffer, incomplete lines
+ * and lines which do not fit into the buffer.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+#include "TinySerialServer.h"
+#include "TestCheck.h"
+
+using namespace telnet;
+
+/// Provides access to the line assembly of the server
+struct TestServer : public TinySerialServer {
+  using TinySerialServer::readLine;
+};
+
+void setup() {
+  Serial.begin(115200);
+  TestServer server;
+  RingBuffer buffer(16);
+  char line[32];
+  // move the start, so that the lines wrap around the end
+  uint8_t tmp[10];
+  buffer.write((const uint8_t*)"0123456789", 10);
+  buffer.readBytes(tmp, 10);
+  buffer.write((const uint8_t*)"abc\r\ndefgh\nij", 13);
+  CHECK(buffer.indexOf('\n') == 4);
+  CHECK(server.readLine(buffer, line, sizeof(line)) == 3);
+  CHECK(StrView(line) == "abc");
+  CHECK(server.readLine(buffer, line, sizeof(line)) == 5);
+  CHECK(StrView(line) == "defgh");
+  // incomplete line
+  CHECK(server.readLine(buffer, line, sizeof(line)) < 0);
+  CHECK(buffer.available() == 2);
+  // a full buffer w/o line end is processed as line
+  buffer.write((const uint8_t*)"klmnopqrstuvwxyz", 16);
+  CHECK(buffer.isFull());
+  CHECK(server.readLine(buffer, line, sizeof(line)) == 16);
+  CHECK(StrView(line) == "ijklmnopqrstuvwx");
+  // lines which are longer than the target are truncated
+  buffer.write((const uint8_t*)"0123456789\n", 11);
+  CHECK(server.readLine(buffer, line, 5) == 4);
+  CHECK(StrView(line) == "0123");
+  CHECK(buffer.available() == 0);
+
+  endChecks();
+}
+
+void loop() {}
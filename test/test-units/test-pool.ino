@@ -0,0 +1,46 @@
+/***
+ * @file test-pool.ino
+ * @brief Checks the PoolAllocator: sorted size classes, the use of the next
+ * bigger class and the fallback for big requests.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+#include "Arduino.h"
+#include "Utils/PoolAllocator.h"
+#include "TestCheck.h"
+
+using namespace telnet;
+
+void setup() {
+  Serial.begin(115200);
+  PoolAllocator pool;
+  pool.addSizeClass(100, 2);
+  pool.addSizeClass(24, 2);
+  CHECK(pool.begin());
+  // the size classes are sorted
+  CHECK(pool.blockSize(0) == 24 && pool.blockSize(1) == 104);
+  void* a = pool.allocate(8);
+  void* b = pool.allocate(20);
+  CHECK(pool.available(0) == 0);
+  // the next bigger class is used when a class is empty
+  void* c = pool.allocate(8);
+  CHECK(pool.available(1) == 1);
+  // too big: fallback
+  void* d = pool.allocate(200);
+  CHECK(d != nullptr && pool.available(1) == 1);
+  pool.free(a);
+  pool.free(b);
+  pool.free(c);
+  pool.free(d);
+  CHECK(pool.available(0) == 2 && pool.available(1) == 2);
+
+  // begin() is called with the first allocation
+  PoolAllocator lazy;
+  void* e = lazy.allocate(16);
+  CHECK(e != nullptr && lazy.sizeClassCount() > 0);
+  lazy.free(e);
+
+  endChecks();
+}
+
+void loop() {}
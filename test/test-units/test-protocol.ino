@@ -0,0 +1,56 @@
+/***
+ * @file test-protocol.ino
+ * @brief Checks the telnet protocol state machine: escaped data bytes, line
+ * ends and commands which are split across reads.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+#include "TelnetProtocol.h"
+#include "TestCheck.h"
+
+using namespace telnet;
+
+void setup() {
+  Serial.begin(115200);
+  TelnetProtocol telnet;
+  Capture out;
+  telnet.reset();
+
+  // IAC IAC is an escaped 255 data byte
+  uint8_t escaped[] = {'a', 255, 255, 'b'};
+  CHECK(telnet.filter(escaped, sizeof(escaped), out) == 3);
+  CHECK(escaped[0] == 'a' && escaped[1] == 255 && escaped[2] == 'b');
+
+  // CR NUL ends the line
+  uint8_t cr_nul[] = {'l', 's', '\r', 0};
+  CHECK(telnet.filter(cr_nul, sizeof(cr_nul), out) == 4);
+  CHECK(cr_nul[2] == '\r' && cr_nul[3] == '\n');
+
+  // the subnegotiation can be split across reads: no byte leaks into the data
+  uint8_t sb1[] = {255, 250, 24, 0, 'x'};
+  uint8_t sb2[] = {'t', 255, 255, 255, 240, 'z'};
+  CHECK(telnet.filter(sb1, sizeof(sb1), out) == 0);
+  CHECK(telnet.filter(sb2, sizeof(sb2), out) == 1);
+  CHECK(sb2[0] == 'z');
+
+  // options are answered, commands are split across reads
+  out.clear();
+  uint8_t cmd1[] = {255};
+  uint8_t cmd2[] = {253, TelnetProtocol::STATUS, 'k'};
+  CHECK(telnet.filter(cmd1, sizeof(cmd1), out) == 0);
+  CHECK(telnet.filter(cmd2, sizeof(cmd2), out) == 1);
+  CHECK(cmd2[0] == 'k');
+  CHECK(out.len > 0 && (uint8_t)out.data[0] == 255);
+
+  // Ctrl-C
+  CHECK(!telnet.isInterrupted());
+  uint8_t interrupt[] = {255, 244};
+  CHECK(telnet.filter(interrupt, sizeof(interrupt), out) == 0);
+  CHECK(telnet.isInterrupted());
+  telnet.reset();
+  CHECK(!telnet.isInterrupted());
+
+  endChecks();
+}
+
+void loop() {}
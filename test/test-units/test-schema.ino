@@ -0,0 +1,61 @@
+/***
+ * @file test-schema.ino
+ * @brief Checks the conversion of the command arguments with a schema:
+ * defaults, options, choices and the rejection of invalid input.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+#include "Utils/ArgSchema.h"
+#include "TestCheck.h"
+
+using namespace telnet;
+
+struct LedArgs {
+  int pin;
+  int mode;
+  bool verbose;
+  const char* name;
+};
+
+static const ArgSpec led_specs[] = {
+    ArgSpec::intArg("PIN", offsetof(LedArgs, pin), 0, 39, 0, true),
+    ArgSpec::enumArg("MODE", offsetof(LedArgs, mode), "off|on|toggle", 1),
+    ArgSpec::flagArg("-v", offsetof(LedArgs, verbose)),
+    ArgSpec::stringArg("-name", offsetof(LedArgs, name), "led"),
+};
+static const ArgSchema led_schema = ArgSchema::create<LedArgs>(led_specs);
+
+bool parseLed(const char* line, LedArgs& values, Print& out) {
+  static char buffer[80];
+  strncpy(buffer, line, sizeof(buffer) - 1);
+  Arguments args;
+  if (!args.parse(buffer)) return false;
+  return led_schema.parse(args, &values, out);
+}
+
+void setup() {
+  Serial.begin(115200);
+  Capture out;
+  LedArgs values;
+  // defaults
+  CHECK(parseLed("led 5", values, out));
+  CHECK(values.pin == 5 && values.mode == 1 && !values.verbose);
+  CHECK(StrView(values.name) == "led");
+  // options can be anywhere and the choices ignore the case
+  CHECK(parseLed("led -v 3 TOGGLE -name x", values, out));
+  CHECK(values.pin == 3 && values.mode == 2 && values.verbose);
+  CHECK(StrView(values.name) == "x");
+  // invalid input is reported
+  out.clear();
+  CHECK(!parseLed("led", values, out));
+  CHECK(out.len > 0);
+  CHECK(!parseLed("led 40", values, out));
+  CHECK(!parseLed("led 3x", values, out));
+  CHECK(!parseLed("led 1 blink", values, out));
+  CHECK(!parseLed("led 1 on extra", values, out));
+  CHECK(!parseLed("led 1 -name", values, out));
+
+  endChecks();
+}
+
+void loop() {}
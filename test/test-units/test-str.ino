@@ -0,0 +1,68 @@
+/***
+ * @file test-str.ino
+ * @brief Checks that moving and swapping strings keeps the content and the
+ * memory of each string with its own allocator.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+#include "Arduino.h"
+#include "Utils/ArenaAllocator.h"
+#include "Utils/PoolAllocator.h"
+#include "Utils/Str.h"
+#include "TestCheck.h"
+
+using namespace telnet;
+
+void setup() {
+  Serial.begin(115200);
+  const char* text1 = "a long string which lives in the arena";
+  const char* text2 = "a long string which lives on the heap!!";
+  ArenaAllocator arena(1024);
+  PoolAllocator pool;
+  pool.addSizeClass(64, 8);
+
+  // short strings are stored inline
+  Str inline_str = "short";
+  CHECK(inline_str == "short");
+
+  // swap and move between different allocators copy the content
+  Str arena_str;
+  arena_str.setAllocator(arena);
+  arena_str = text1;
+  Str heap_str = text2;
+  arena_str.swap(heap_str);
+  CHECK(arena_str == text2 && heap_str == text1);
+  heap_str = stl::move(arena_str);
+  CHECK(heap_str == text2);
+
+  // the moved string must not refer to the arena any more
+  arena.reset();
+  Str overwrite;
+  overwrite.setAllocator(arena);
+  overwrite = "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx";
+  CHECK(heap_str == text2);
+
+  // swap with the same allocator and between pool and heap
+  Str pool1, pool2;
+  pool1.setAllocator(pool);
+  pool2.setAllocator(pool);
+  pool1 = text1;
+  pool2 = text2;
+  pool1.swap(pool2);
+  CHECK(pool1 == text2 && pool2 == text1);
+  pool1.swap(heap_str);
+  CHECK(pool1 == text2 && heap_str == text2);
+
+  // swap via the base class with a view
+  char buffer[64] = "view";
+  StrView view(buffer, sizeof(buffer) - 1, 4);
+  Str str = text1;
+  StrView& base = str;
+  base.swap(view);
+  CHECK(str == "view");
+  CHECK(StrView(buffer) == text1);
+
+  endChecks();
+}
+
+void loop() {}
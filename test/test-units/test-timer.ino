@@ -0,0 +1,46 @@
+/***
+ * @file test-timer.ino
+ * @brief Checks the timer wheel which closes the idle sessions: expiry,
+ * cancelling, big time jumps and the wraparound of millis().
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+#include "Utils/TimerWheel.h"
+#include "TestCheck.h"
+
+using namespace telnet;
+
+void setup() {
+  Serial.begin(115200);
+  // start just before the wraparound of millis()
+  unsigned long starts[] = {0, 0xFFFFF000UL, 0xFFFFFFFFUL - 500};
+  for (unsigned long start : starts) {
+    TimerWheel<4, 8> wheel;
+    wheel.begin(start, 100);
+    long fired[4] = {-1, -1, -1, -1};
+    wheel.schedule(0, start + 5000);
+    wheel.schedule(1, start + 250);
+    // expired timers are reported with the next tick
+    wheel.schedule(2, start - 50);
+    wheel.schedule(3, start + 2000);
+    wheel.cancel(3);
+    CHECK(wheel.nextExpiry(start) == 100);
+    for (long t = 0; t <= 6000; t += 10) {
+      wheel.expire(start + t, [&](int id) { fired[id] = t; });
+    }
+    CHECK(fired[0] == 5000);
+    CHECK(fired[1] == 300);
+    CHECK(fired[2] == 100);
+    CHECK(fired[3] == -1);
+    CHECK(wheel.nextExpiry(start + 6000) == -1);
+    // a big jump reports the timer
+    wheel.schedule(3, start + 7000);
+    CHECK(wheel.isScheduled(3));
+    wheel.expire(start + 100000, [&](int id) { fired[id] = 100000; });
+    CHECK(fired[3] == 100000 && !wheel.isScheduled(3));
+  }
+
+  endChecks();
+}
+
+void loop() {}
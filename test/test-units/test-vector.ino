@@ -0,0 +1,46 @@
+/***
+ * @file test-vector.ino
+ * @brief Checks that the Vector keeps its elements when it relocates them:
+ * growing, erasing, inserting at the front, reserving and moving.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+#include "Arduino.h"
+#include "Utils/Str.h"
+#include "Utils/Vector.h"
+#include "TestCheck.h"
+
+using namespace telnet;
+
+void setup() {
+  Serial.begin(115200);
+  Vector<Str> list;
+  char tmp[40];
+  // relocation keeps the content of the strings
+  for (int j = 0; j < 100; j++) {
+    snprintf(tmp, sizeof(tmp), "a long file name number %d.mp3", j);
+    list.emplace_back(tmp);
+  }
+  CHECK(list.size() == 100);
+  CHECK(list[0] == "a long file name number 0.mp3");
+  CHECK(list[99] == "a long file name number 99.mp3");
+  list.erase(0);
+  CHECK(list[0] == "a long file name number 1.mp3");
+  list.push_front(Str("front"));
+  CHECK(list[0] == "front" && list.size() == 100);
+  list.reserve(500);
+  CHECK(list.capacity() >= 500 && list[99] == "a long file name number 99.mp3");
+  list.shrink_to_fit();
+  CHECK(list[99] == "a long file name number 99.mp3");
+  Vector<Str> moved(stl::move(list));
+  CHECK(moved.size() == 100 && list.size() == 0);
+
+  // trivially copyable elements
+  Vector<int> numbers;
+  for (int j = 0; j < 1000; j++) numbers.push_back(j);
+  CHECK(numbers.size() == 1000 && numbers[0] == 0 && numbers[999] == 999);
+
+  endChecks();
+}
+
+void loop() {}